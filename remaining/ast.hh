@@ -249,6 +249,11 @@ public:
     virtual void optimize();
     virtual sym_index generate_quads(quad_list&) = 0;
 
+    // Generate quads jumping to a label if the expression is true (last
+    // arg 1) or false (0), falling through otherwise. Used for conditions,
+    // see quads.cc.
+    virtual void generate_jump(quad_list&, int, int);
+
     // Used for safe downcasting. We could provide a mechanism to safely
     // downcast ALL ast nodes... But these ones are the only ones we'll need
     // in this lab course. They will be used during AST optimization.
@@ -760,6 +765,7 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list&);
+    virtual void generate_jump(quad_list&, int, int);
 };
 
 
@@ -996,6 +1002,7 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list&);
+    virtual void generate_jump(quad_list&, int, int);
 
     // Safe downcasts.
     virtual ast_or* get_ast_binaryoperation() { return this; }
@@ -1020,6 +1027,7 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list&);
+    virtual void generate_jump(quad_list&, int, int);
 
     // Safe downcasts.
     virtual ast_and* get_ast_binaryoperation() { return this; }
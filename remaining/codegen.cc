@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <fstream>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "symtab.hh"
 #include "quads.hh"
@@ -11,6 +12,7 @@ using namespace std;
 
 
 extern int assembler_trace; // Defined in main.cc.
+extern int sparc_v8;        // Ditto.
 
 // Used in parser.y. Ideally the filename should be parametrized, but it's not
 // _that_ important...
@@ -20,7 +22,15 @@ code_generator *code_gen = new code_generator("d.out");
 // Constructor.
 code_generator::code_generator(const char *object_file_name) {
 
-    out.open(object_file_name);
+    object_file.open(object_file_name);
+    max_lines = 256;
+    lines = new asm_line[max_lines];
+    nr_lines = 0;
+    max_literals = 16;
+    literals = new pool_literal[max_literals];
+    nr_literals = 0;
+    nr_written = 0;
+    leaf = 0;
     
     // Initialize register array.
     strcpy(reg[static_cast<int>(o0)], "%o0");
@@ -33,9 +43,21 @@ code_generator::code_generator(const char *object_file_name) {
     strcpy(reg[static_cast<int>(f0)], "%f0");
     strcpy(reg[static_cast<int>(f1)], "%f1");
     strcpy(reg[static_cast<int>(f2)], "%f2");
+    strcpy(reg[static_cast<int>(l1)], "%l1");
+    strcpy(reg[static_cast<int>(l2)], "%l2");
+    strcpy(reg[static_cast<int>(l3)], "%l3");
+    strcpy(reg[static_cast<int>(l4)], "%l4");
+    strcpy(reg[static_cast<int>(l5)], "%l5");
+    strcpy(reg[static_cast<int>(l6)], "%l6");
+    strcpy(reg[static_cast<int>(l7)], "%l7");
+    strcpy(reg[static_cast<int>(i1)], "%i1");
+    strcpy(reg[static_cast<int>(i2)], "%i2");
+    strcpy(reg[static_cast<int>(i3)], "%i3");
+    strcpy(reg[static_cast<int>(i4)], "%i4");
+    strcpy(reg[static_cast<int>(i5)], "%i5");
     
     // Contains the preinstalled diesel functions: read, write, trunc.
-    out << "#include \"diesel_glue.s\"" << endl;
+    object_file << "#include \"diesel_glue.s\"" << endl;
 }
 
 
@@ -43,8 +65,8 @@ code_generator::code_generator(const char *object_file_name) {
 /* Destructor. */
 code_generator::~code_generator() {
     // Make sure we close the outfile before exiting the compiler.
-    out << flush;
-    out.close();
+    object_file << flush;
+    object_file.close();
 }
 
 
@@ -53,9 +75,20 @@ code_generator::~code_generator() {
    The argument is a quad_list representing the body of the procedure, and
    the symbol for the environment for which code is being generated. */
 void code_generator::generate_assembler(quad_list *q, symbol *env) {
+    this->env = env;
     prologue(env);
     expand(q);
     epilogue(env);
+    // The code has only been collected in out so far. It is written to the
+    // file once the nops after branches and calls have been dealt with.
+    fill_delay_slots();
+    write_literals();
+    // The main program comes after the routines it contains, but with the
+    // -w flag the specialized copies of routines follow it (see
+    // optimize_program() in quadopt.cc). write_globals() switches back to
+    // .text, so their code still ends up where it belongs.
+    if(env->level == 0)
+	write_globals(env->get_procedure_symbol()->ar_size);
 }
 
 
@@ -84,14 +117,22 @@ void code_generator::prologue(symbol *new_env) {
     // is known here (ar_size).
     if(new_env->tag == SYM_PROC) {
 	procedure_symbol *proc = new_env->get_procedure_symbol();
-	ar_size = align(proc->ar_size + MIN_FRAME_SIZE);
+	// The main program's variables are in .bss (see write_globals()).
+	if(new_env->level == 0)
+	    ar_size = align(MIN_FRAME_SIZE);
+	else
+	    ar_size = align(proc->ar_size + MIN_FRAME_SIZE);
 	label_nr = proc->label_nr;
 	last_arg = proc->last_parameter;
+	leaf = proc->is_leaf;
+	saves_display = proc->sets_display;
     } else if(new_env->tag == SYM_FUNC) {
 	function_symbol *func = new_env->get_function_symbol();
 	ar_size = align(func->ar_size + MIN_FRAME_SIZE);
 	label_nr = func->label_nr;
 	last_arg = func->last_parameter;
+	leaf = func->is_leaf;
+	saves_display = func->sets_display;
     } else {
 	fatal("code_generator::prologue() called for non-proc/func");
 	return;
@@ -104,13 +145,36 @@ void code_generator::prologue(symbol *new_env) {
 	out << "\t" << "! PROLOGUE (" << short_symbols << new_env
 	    << long_symbols << ")" << endl;
 
+    // Our own variables are reached through %fp, so the display register
+    // of our level is only set if a routine nested inside us uses it (see
+    // note_display_uses() in quads.cc). A leaf has no nested routines
+    // using its variables, and the main program sets its display register
+    // once and for all below.
+    int level = new_env->level + 1;
+    if(leaf || level == GLOBAL_LEVEL)
+	saves_display = 0;
+
+    // A leaf routine has no frame or display entry to set up, and its
+    // arguments only need to be moved to their registers.
+    if(leaf) {
+	move_leaf_arguments(last_arg);
+	out << flush;
+	return;
+    }
+
     /* Your code here. */
     out << "\t\t" << "set" << "\t" << -ar_size << ",%l0" << endl
 	<< "\t\t" << "save" << "\t" << "%sp,%l0,%sp" << endl;
-    int level = new_env->level + 1;
-    out << "\t\t" << "st" << "\t%g" << level << ",[%fp"
-	<< std::showpos << DISPLAY_REG_OFFSET << std::noshowpos << "]" << endl
-	<< "\t\t" << "mov" << "\t%fp,%g" << level << endl;
+    // The display register of the main program's variables is set once,
+    // and keeps its value for the rest of the run.
+    if(level == GLOBAL_LEVEL)
+	out << "\t\t" << "set" << "\t" << GLOBALS_LABEL << ",%g" << level
+	    << endl;
+    else if(saves_display)
+	out << "\t\t" << "st" << "\t%g" << level << ",[%fp"
+	    << std::showpos << DISPLAY_REG_OFFSET << std::noshowpos << "]"
+	    << endl
+	    << "\t\t" << "mov" << "\t%fp,%g" << level << endl;
     int offset = FIRST_ARG_OFFSET;
     arg = last_arg;
     for(int narg = 0; arg; ++narg, arg = arg->preceding) {
@@ -118,6 +182,14 @@ void code_generator::prologue(symbol *new_env) {
 	    << std::showpos << offset << std::noshowpos << "]" << endl;
 	offset += arg->size;
     }
+    // Now that the %i registers are free, parameters kept in registers can
+    // be loaded into them. One which is assigned before it is read may
+    // share its register with another one, and must be left out.
+    for(arg = last_arg; arg; arg = arg->preceding)
+	if(arg->reg != NO_REGISTER && arg->live_on_entry)
+	    out << "\t\t" << "ld" << "\t[%fp" << std::showpos
+		<< FIRST_ARG_OFFSET + arg->offset << std::noshowpos << "],"
+		<< reg[static_cast<int>(register_variables[arg->reg])] << endl;
     
     out << flush;    
 }
@@ -133,9 +205,18 @@ void code_generator::epilogue(symbol *old_env) {
 	    << long_symbols << ")" << endl;
     /* Your code here. */
 
-    out << "\t\t" << "ld" << "\t[%fp" << std::showpos << DISPLAY_REG_OFFSET << std::noshowpos
-	<< "],%g" << old_env->level + 1 << endl
-	<< "\t\t" << "ret" << endl
+    // A leaf routine returns to the address its caller's call left in %o7.
+    if(leaf) {
+	out << "\t\t" << "retl" << endl
+	    << "\t\t" << "nop" << endl;
+	out << flush;
+	return;
+    }
+
+    if(saves_display)
+	out << "\t\t" << "ld" << "\t[%fp" << std::showpos << DISPLAY_REG_OFFSET
+	    << std::noshowpos << "],%g" << old_env->level + 1 << endl;
+    out << "\t\t" << "ret" << endl
 	<< "\t\t" << "restore" << endl;
     
     out << flush;    
@@ -143,6 +224,70 @@ void code_generator::epilogue(symbol *old_env) {
 
 
 
+/* Move the arguments of a leaf routine from the %o registers they arrive in
+   to the registers the quad optimizer gave them. The moves have to be done
+   in an order where no register is written before the argument it holds
+   has been moved away. Each time, we take a move whose register isn't
+   still holding another argument. When there is none, the rest of them go
+   round in circles, and one argument is moved out of the way into %o0
+   first. It only holds an argument waiting to be moved as long as there
+   is a move to take, since %o0 is never given to a variable. Parameters
+   which are assigned before they are read are left out, as in
+   prologue(). */
+void code_generator::move_leaf_arguments(parameter_symbol *last_arg) {
+    register_type from[NR_LEAF_REGISTERS], to[NR_LEAF_REGISTERS];
+    int nr_moves = 0;
+    int k, j;
+
+    // The argument at offset 4 * i arrives in %oi.
+    for(parameter_symbol *arg = last_arg; arg; arg = arg->preceding)
+	if(arg->reg != NO_REGISTER && arg->live_on_entry) {
+	    from[nr_moves] = o0 + arg->offset / 4;
+	    to[nr_moves] = leaf_registers[arg->reg];
+	    nr_moves++;
+	}
+
+    while(nr_moves > 0) {
+	for(k = 0; k < nr_moves; k++) {
+	    for(j = 0; j < nr_moves; j++)
+		if(j != k && from[j] == to[k])
+		    break;
+	    if(j == nr_moves)
+		break;
+	}
+	if(k == nr_moves) {
+	    out << "\t\t" << "mov" << "\t" << reg[static_cast<int>(from[0])]
+		<< ",%o0" << endl;
+	    from[0] = o0;
+	    continue;
+	}
+	if(from[k] != to[k])
+	    out << "\t\t" << "mov" << "\t" << reg[static_cast<int>(from[k])]
+		<< "," << reg[static_cast<int>(to[k])] << endl;
+	nr_moves--;
+	from[k] = from[nr_moves];
+	to[k] = to[nr_moves];
+    }
+}
+
+
+
+/* Return the register pointing at the frame of the routine whose variables
+   are at the given level. That is %fp for the current routine, and the
+   display register of the level for an enclosing one, which the enclosing
+   routine then has to set. The main program's variables are not in a
+   frame, and are always reached through their display register. */
+const char *code_generator::frame_register(int level) {
+    if(level == GLOBAL_LEVEL)
+	return "%g1";
+    if(level == env->level + 1)
+	return "%fp";
+    sprintf(display_name, "%%g%d", level);
+    return display_name;
+}
+
+
+
 /* This function finds the display register level and offset for a variable or
    a parameter. Note the pass-by-reference arguments. */
 void code_generator::find(sym_index sym_p, int *level, int *offset) {
@@ -163,38 +308,149 @@ void code_generator::find(sym_index sym_p, int *level, int *offset) {
 
 
 
+/* Returns 1 for the float registers. The others are integer registers. */
+static int is_float_register(register_type r) {
+    return r == f0 || r == f1 || r == f2;
+}
+
+
+/* Return the register a variable or temporary is kept in, or -1 if it is
+   kept in memory. The quad optimizer decides which ones are (see
+   quadopt.cc), so with the -f flag, all are in memory. In a leaf routine,
+   the registers are taken from another table. */
+register_type code_generator::register_of(sym_index sym_p) {
+    if(sym_p == NULL_SYM)
+	return -1;
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if((sym->tag != SYM_VAR && sym->tag != SYM_PARAM) ||
+       sym->reg == NO_REGISTER)
+	return -1;
+    if(leaf)
+	return leaf_registers[sym->reg];
+    return register_variables[sym->reg];
+}
+
+
+/* Return the register holding a symbol, fetching it into the register
+   given if it isn't kept in one. Only integer registers can be used. */
+register_type code_generator::source(sym_index sym_p,
+				     register_type scratch) {
+    register_type r = register_of(sym_p);
+    if(r >= 0)
+	return r;
+    fetch(sym_p, scratch);
+    return scratch;
+}
+
+
+/* Return the register an integer result should be computed into, which
+   is the register of the symbol receiving it if it has one, and the one
+   given otherwise. Either way, it should then be passed on to store(),
+   which does nothing in the first case. */
+register_type code_generator::target(sym_index sym_p,
+				     register_type scratch) {
+    register_type r = register_of(sym_p);
+    return (r >= 0 ? r : scratch);
+}
+
+
+/* Emit a SPARC V8 signed division of src1 by src2 into dest (the -m flag).
+   sdiv divides the 64-bit number %y:src1, so %y must first be filled with
+   the sign of src1. A write to %y takes effect only after up to three
+   instructions, which is why the nops are needed. Uses %o3. */
+void code_generator::divide(register_type src1, register_type src2,
+			    register_type dest) {
+    out << "\t\t" << "sra" << "\t" << reg[static_cast<int>(src1)]
+	<< ",31,%o3" << endl;
+    out << "\t\t" << "wr" << "\t" << "%o3,%g0,%y" << endl;
+    out << "\t\t" << "nop" << endl;
+    out << "\t\t" << "nop" << endl;
+    out << "\t\t" << "nop" << endl;
+    out << "\t\t" << "sdiv" << "\t" << reg[static_cast<int>(src1)] << ","
+	<< reg[static_cast<int>(src2)] << "," << reg[static_cast<int>(dest)]
+	<< endl;
+}
+
+
+/* Set dest to 1 if src1 < src2 as signed numbers, and to 0 otherwise,
+   without a branch. The only condition code we can read without branching
+   is the carry, through addx and subx, and after cmp it tells whether
+   src1 < src2 as unsigned numbers. Seen as signed, a number is its
+   unsigned value minus 2^32 times its sign bit, so src1 - src2 is
+   2^32 * (sign2 - sign1 - carry) plus something between 0 and 2^32. It is
+   negative exactly when sign2 - sign1 - carry is, and sra gives us -sign1
+   and -sign2. Uses %o2 and %o3. */
+void code_generator::less_than(register_type src1, register_type src2,
+			       register_type dest) {
+    out << "\t\t" << "sra" << "\t" << reg[static_cast<int>(src1)]
+	<< ",31,%o2" << endl;
+    out << "\t\t" << "sra" << "\t" << reg[static_cast<int>(src2)]
+	<< ",31,%o3" << endl;
+    out << "\t\t" << "cmp" << "\t" << reg[static_cast<int>(src1)] << ","
+	<< reg[static_cast<int>(src2)] << endl;
+    out << "\t\t" << "subx" << "\t" << "%o2,%o3,%o2" << endl;
+    out << "\t\t" << "srl" << "\t" << "%o2,31," << reg[static_cast<int>(dest)]
+	<< endl;
+}
+
+
 /* This function fetches the value of a variable or a constant into a
    register. */
 void code_generator::fetch(sym_index sym_p, register_type dest) {
     /* Your code here. */
     int level, offset;
     symbol* sym;
+    register_type r = register_of(sym_p);
+    if(r >= 0) {
+	// Moving between integer and float registers has to take the way
+	// through memory.
+	if(is_float_register(dest))
+	    out << "\t\t" << "st" << "\t" << reg[static_cast<int>(r)]
+		<< ",[%sp+64]" << endl
+		<< "\t\t" << "ld" << "\t[%sp+64],"
+		<< reg[static_cast<int>(dest)] << endl;
+	else if(r != dest)
+	    out << "\t\t" << "mov" << "\t" << reg[static_cast<int>(r)] << ","
+		<< reg[static_cast<int>(dest)] << endl;
+	return;
+    }
     if(sym_p != NULL_SYM) {
     	sym = sym_tab->get_symbol(sym_p);
     	if(sym->tag == SYM_CONST) {
     	    constant_symbol* csym = sym->get_constant_symbol();
-    	    if(csym->type == integer_type) {
+	    // Only the integer registers can be set directly. A constant
+	    // going to a float register (real, or an integer such as the
+	    // argument of q_itor) is loaded from the literal pool instead.
+    	    if(csym->type == integer_type && !is_float_register(dest)) {
     		out << "\t\t" << "set" << '\t' << csym->const_value.ival
     		    << ',' << reg[static_cast<int>(dest)] << endl;
     	    }
     	    else {
-    		out << "\t\t" << "set" << '\t' << csym->const_value.ival
-    		    << ",%l0" << endl
-		    << "\t\t" << "st" << "\t%l0,[%sp+64]" << endl
-		    << "\t\t" << "ld" << "\t[%sp+64],"
+		int label = literal_label(csym->const_value.ival);
+		out << "\t\t" << "sethi" << "\t%hi(L" << label << "),%l0"
+		    << endl
+		    << "\t\t" << "ld" << "\t[%l0+%lo(L" << label << ")],"
 		    << reg[static_cast<int>(dest)] << endl;
     	    }
     	    return ;
     	}
     }
     find(sym_p, &level, &offset);
-    if (offset > 4095 || offset < -4096) {
+    // The address of a variable in .bss is known to the assembler, so a
+    // large offset costs no more than it does for a constant in the pool.
+    if ((offset > 4095 || offset < -4096) && level == GLOBAL_LEVEL) {
+      out << "\t\t" << "sethi" << "\t%hi(" << GLOBALS_LABEL << std::showpos
+	  << offset << "),%l0" << endl
+	  << "\t\t" << "ld" << "\t[%l0+%lo(" << GLOBALS_LABEL << offset
+	  << std::noshowpos << ")]," << reg[static_cast<int>(dest)] << endl;
+    }
+    else if (offset > 4095 || offset < -4096) {
       out << "\t\t" << "set" << '\t' << offset << ",%l0" << endl
-      	  << "\t\t" << "ld" << "\t[%g" << level << "+%l0],"
+      	  << "\t\t" << "ld" << "\t[" << frame_register(level) << "+%l0],"
       	  << reg[static_cast<int>(dest)] << endl;
     }
     else {
-      out << "\t\t" << "ld" << "\t[%g" << level
+      out << "\t\t" << "ld" << "\t[" << frame_register(level)
 	  << std::showpos << offset << std::noshowpos
 	  << "]," << reg[static_cast<int>(dest)] << endl;
     }
@@ -206,16 +462,35 @@ void code_generator::fetch(sym_index sym_p, register_type dest) {
 void code_generator::store(register_type src, sym_index sym_p) {
     /* Your code here. */
     int level, offset;
+    register_type r = register_of(sym_p);
+    if(r >= 0) {
+	if(is_float_register(src))
+	    out << "\t\t" << "st" << "\t" << reg[static_cast<int>(src)]
+		<< ",[%sp+64]" << endl
+		<< "\t\t" << "ld" << "\t[%sp+64],"
+		<< reg[static_cast<int>(r)] << endl;
+	else if(r != src)
+	    out << "\t\t" << "mov" << "\t" << reg[static_cast<int>(src)]
+		<< "," << reg[static_cast<int>(r)] << endl;
+	return;
+    }
     find(sym_p, &level, &offset);
-    if (offset > 4095 || offset < -4096) {
+    if ((offset > 4095 || offset < -4096) && level == GLOBAL_LEVEL) {
+      out << "\t\t" << "sethi" << "\t%hi(" << GLOBALS_LABEL << std::showpos
+	  << offset << "),%l0" << endl
+	  << "\t\t" << "st" << "\t" << reg[static_cast<int>(src)]
+	  << ",[%l0+%lo(" << GLOBALS_LABEL << offset << std::noshowpos
+	  << ")]" << endl;
+    }
+    else if (offset > 4095 || offset < -4096) {
       out << "\t\t" << "set" << '\t' << offset << ",%l0" << endl
 	  << "\t\t" << "st" << "\t" << reg[static_cast<int>(src)]
-	  << ",[%g" << level
+	  << ",[" << frame_register(level)
 	  << "+%l0]" << endl;
     }
     else {
       out << "\t\t" << "st" << "\t" << reg[static_cast<int>(src)]
-	  << ",[%g" << level
+	  << ",[" << frame_register(level)
 	  << std::showpos << offset << std::noshowpos
 	  << "]" << endl;
     }
@@ -223,18 +498,77 @@ void code_generator::store(register_type src, sym_index sym_p) {
 
 
 
+/* Return the label of a constant in the literal pool, adding it if it isn't
+   there already. Constants are told apart by their bits, so that a real
+   and an integer with the same bits share a word. */
+int code_generator::literal_label(int bits) {
+    for(int i = 0; i < nr_literals; i++)
+	if(literals[i].bits == bits)
+	    return literals[i].label;
+
+    if(nr_literals == max_literals) {
+	pool_literal *tmp = new pool_literal[2 * max_literals];
+	for(int i = 0; i < nr_literals; i++)
+	    tmp[i] = literals[i];
+	delete[] literals;
+	literals = tmp;
+	max_literals *= 2;
+    }
+    literals[nr_literals].bits = bits;
+    literals[nr_literals].label = sym_tab->get_next_label();
+    return literals[nr_literals++].label;
+}
+
+
+/* Write the constants added to the literal pool by the last routine to the
+   file. Every routine is followed by the ones it was first to use, since
+   we don't know which routine is the last one. */
+void code_generator::write_literals() {
+    if(nr_written == nr_literals)
+	return;
+    object_file << "\t" << ".section" << "\t" << "\".rodata\"" << endl
+		<< "\t" << ".align" << "\t" << 4 << endl;
+    for(; nr_written < nr_literals; nr_written++)
+	object_file << "L" << literals[nr_written].label << ":\t"
+		    << ".word" << "\t" << "0x" << hex << setw(8) << setfill('0')
+		    << static_cast<unsigned int>(literals[nr_written].bits)
+		    << dec << setfill(' ') << endl;
+    object_file << "\t" << ".section" << "\t" << "\".text\"" << endl
+		<< flush;
+}
+
+
+
+/* Write the variables of the main program, which are laid out below
+   GLOBALS_LABEL the way those of a routine are laid out below %fp. The
+   main program's own frame is then no larger than that of any routine. */
+void code_generator::write_globals(int size) {
+    object_file << "\t" << ".section" << "\t" << "\".bss\"" << endl
+		<< "\t" << ".align" << "\t" << 8 << endl
+		<< "\t" << ".skip" << "\t" << align(size) << endl
+		<< GLOBALS_LABEL << ":" << endl
+		<< "\t" << ".section" << "\t" << "\".text\"" << endl
+		<< flush;
+}
+
+
+
 /* This function fetches the base address of an array. */
 void code_generator::array_address(sym_index sym_p, register_type dest) {
     /* Your code here. */
     array_symbol* asym = sym_tab->get_symbol(sym_p)->get_array_symbol();
     int offset = asym->offset + 4 * asym->array_cardinality;
-    if (offset > 4095 || offset < -4096) {
+    if ((offset > 4095 || offset < -4096) && asym->level == GLOBAL_LEVEL) {
+      out << "\t\t" << "set" << '\t' << GLOBALS_LABEL << '-' << offset
+	  << ',' << reg[static_cast<int>(dest)] << endl;
+    }
+    else if (offset > 4095 || offset < -4096) {
       out << "\t\t" << "set" << '\t' << offset << ",%l0" << endl
-	  << "\t\t" << "sub" << "\t%g" << asym->level
+	  << "\t\t" << "sub" << "\t" << frame_register(asym->level)
 	  << ",%l0," << reg[static_cast<int>(dest)] << endl;
     }
     else {
-      out << "\t\t" << "sub" << "\t%g" << asym->level
+      out << "\t\t" << "sub" << "\t" << frame_register(asym->level)
 	  << ',' << offset
 	  << ',' << reg[static_cast<int>(dest)] << endl;
     }
@@ -242,10 +576,107 @@ void code_generator::array_address(sym_index sym_p, register_type dest) {
 
 
 
+/* Returns 1 if a call can be made as a tail call, ie, by jumping to the
+   callee instead of calling it, letting it return straight to our own
+   caller. That is right if we return as soon as the call is done (with its
+   result, for a function), and possible if the callee doesn't need our
+   frame: it mustn't be nested inside the current routine, since it then
+   reaches our variables through the display. The arguments must all fit in
+   registers. The main program may make tail calls too, since it is called
+   by main in diesel_glue.s like any routine, and the callee then returns
+   there instead. All the routines it declares are nested inside it,
+   though, so it only makes them to read and write in diesel_glue.s. The
+   iterator is positioned at the call, and we look past the labels and
+   forward jumps after it, to see what is done next. */
+int code_generator::is_tail_call(quadruple *call, quad_list_iterator *pos,
+				 int last_label) {
+    if(env->tag != SYM_PROC && env->tag != SYM_FUNC)
+	return 0;
+    if(sym_tab->get_symbol(call->sym1)->level > env->level ||
+       call->int2 > 6)
+	return 0;
+
+    // Skip labels, and follow jumps further down.
+    quad_list_iterator next = *pos;
+    quadruple *q;
+    int target = -1;
+    for(q = next.get_next(); q != NULL; q = next.get_next()) {
+	if(q->op_code == q_labl) {
+	    if(q->int1 == target)
+		target = -1;
+	} else if(target < 0) {
+	    if(q->op_code != q_jmp || q->int1 == last_label)
+		break;
+	    target = q->int1;
+	}
+    }
+    if(target >= 0)
+	return 0;
+
+    if(call->sym3 != NULL_SYM)
+	return q != NULL &&
+	    (q->op_code == q_ireturn || q->op_code == q_rreturn) &&
+	    q->sym2 == call->sym3;
+    return q == NULL || (q->op_code == q_jmp && q->int1 == last_label);
+}
+
+
+
+/* Returns 1 if a symbol is an integer constant small enough to be the
+   immediate operand of an instruction. */
+static int is_small_constant(sym_index sym_p) {
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if(sym->tag != SYM_CONST || sym->type != integer_type)
+	return 0;
+    int value = sym->get_constant_symbol()->const_value.ival;
+    return value >= -4096 && value < 4096;
+}
+
+
+/* Return the branch instruction of one of the conditional jumps made by the
+   quad optimizer (see quads.hh). The real ones are float branches, where
+   the orderings are negated by also branching on unordered. */
+static const char *branch_for(quad_op_type op) {
+    switch(op) {
+    case q_jieq:
+	return "be";
+    case q_jine:
+	return "bne";
+    case q_jilt:
+	return "bl";
+    case q_jige:
+	return "bge";
+    case q_jigt:
+	return "bg";
+    case q_jile:
+	return "ble";
+    case q_jreq:
+	return "fbe";
+    case q_jrne:
+	return "fbne";
+    case q_jrlt:
+	return "fbl";
+    case q_jrge:
+	return "fbuge";
+    case q_jrgt:
+	return "fbg";
+    case q_jrle:
+	return "fbule";
+    default:
+	fatal("branch_for(): not a conditional jump");
+	return "nop";
+    }
+}
+
+
+
 /* This method expands a quad_list into assembler code, quad for quad. */
 void code_generator::expand(quad_list *q_list) {
     quadruple *q;           // Used to iterate through the list.
     int label;              // Assembler label.
+    register_type dest;     // Where the result is computed.
+    register_type src1;     // Where the operands are read from.
+    register_type src2;
     
     int nr_args = 0;            // Used for parameter generation.
     sym_index args_sym[512];
@@ -276,19 +707,23 @@ void code_generator::expand(quad_list *q_list) {
 	switch(q->op_code) {
 	    case q_iload:
 	    case q_rload:
-		out << "\t\t" << "set" << "\t" << q->int1 << ",%o0" << endl;
-		store(o0, q->sym3);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "set" << "\t" << q->int1 << ","
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_inot:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;
-		out << "\t\t" << "be,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		// subcc from %g0 sets the carry unless the operand is 0, so
+		// 1 - carry is the result. Integer relations are done the same
+		// way below, so none of them needs a branch.
+		src1 = source(q->sym1, o0);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "subcc" << "\t" << "%g0,"
+		    << reg[static_cast<int>(src1)] << ",%g0" << endl;
+		out << "\t\t" << "subx" << "\t" << "%g0,-1,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_ruminus:
@@ -298,9 +733,11 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_iuminus:
-		fetch(q->sym1, o0);
-		out << "\t\t" << "neg" << "\t" << "%o0" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "neg" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rplus:
@@ -311,10 +748,13 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_iplus:
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "add" << "\t" << "%o0,%o1,%o0" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "add" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(src2)] << ","
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rminus:
@@ -325,40 +765,40 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_iminus:
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "sub" << "\t" << "%o0,%o1,%o0" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "sub" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(src2)] << ","
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_ior:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;
-		out << "\t\t" << "bne,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		fetch(q->sym2, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;
-		out << "\t\t" << "bne,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "or" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(src2)] << ",%o2" << endl;
+		out << "\t\t" << "subcc" << "\t" << "%g0,%o2,%g0" << endl;
+		out << "\t\t" << "addx" << "\t" << "%g0,0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_iand:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;
-		out << "\t\t" << "be,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		fetch(q->sym2, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;
-		out << "\t\t" << "be,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "subcc" << "\t" << "%g0,"
+		    << reg[static_cast<int>(src1)] << ",%g0" << endl;
+		out << "\t\t" << "addx" << "\t" << "%g0,0,%o2" << endl;
+		out << "\t\t" << "subcc" << "\t" << "%g0,"
+		    << reg[static_cast<int>(src2)] << ",%g0" << endl;
+		out << "\t\t" << "addx" << "\t" << "%o2,0,%o2" << endl;
+		out << "\t\t" << "srl" << "\t" << "%o2,1,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rmult:
@@ -369,6 +809,17 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_imult:
+		if(sparc_v8) {
+		    src1 = source(q->sym1, o0);
+		    src2 = source(q->sym2, o1);
+		    dest = target(q->sym3, o0);
+		    out << "\t\t" << "smul" << "\t"
+			<< reg[static_cast<int>(src1)] << ","
+			<< reg[static_cast<int>(src2)] << ","
+			<< reg[static_cast<int>(dest)] << endl;
+		    store(dest, q->sym3);
+		    break;
+		}
 		fetch(q->sym1, o0);
 		fetch(q->sym2, o1);
 		// Note: We're calling routines from diesel_glue.s here.
@@ -387,6 +838,14 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_idivide:
+		if(sparc_v8) {
+		    src1 = source(q->sym1, o0);
+		    src2 = source(q->sym2, o1);
+		    dest = target(q->sym3, o0);
+		    divide(src1, src2, dest);
+		    store(dest, q->sym3);
+		    break;
+		}
 		fetch(q->sym1, o0);
 		fetch(q->sym2, o1);
 		// Note: We're calling routines from diesel_glue.s here.
@@ -396,6 +855,21 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_imod:
+		if(sparc_v8) {
+		    // There's no remainder instruction, so we compute
+		    // a - (a / b) * b, which rounds the same way as .rem.
+		    src1 = source(q->sym1, o0);
+		    src2 = source(q->sym2, o1);
+		    dest = target(q->sym3, o0);
+		    divide(src1, src2, o2);
+		    out << "\t\t" << "smul" << "\t" << "%o2,"
+			<< reg[static_cast<int>(src2)] << ",%o2" << endl;
+		    out << "\t\t" << "sub" << "\t"
+			<< reg[static_cast<int>(src1)] << ",%o2,"
+			<< reg[static_cast<int>(dest)] << endl;
+		    store(dest, q->sym3);
+		    break;
+		}
 		fetch(q->sym1, o0);
 		fetch(q->sym2, o1);
 		// Note: We're calling routines from diesel_glue.s here.
@@ -408,113 +882,120 @@ void code_generator::expand(quad_list *q_list) {
 		label = sym_tab->get_next_label();
 		fetch(q->sym1, f0);
 		fetch(q->sym2, f1);
+		dest = target(q->sym3, o0);
 		out << "\t\t" << "fcmps" << "\t" << "%f0,%f1" << endl;
 		out << "\t\t" << "nop" << endl;
 		out << "\t\t" << "fbne,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
+		out << "\t\t" << "mov" << "\t" << "0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		out << "\t\t" << "mov" << "\t" << "1,"
+		    << reg[static_cast<int>(dest)] << endl;
 		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_ieq:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "cmp" << "\t" << "%o0,%o1" << endl;
-		out << "\t\t" << "bne,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "xor" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(src2)] << ",%o2" << endl;
+		out << "\t\t" << "subcc" << "\t" << "%g0,%o2,%g0" << endl;
+		out << "\t\t" << "subx" << "\t" << "%g0,-1,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rne:
 		label = sym_tab->get_next_label();
 		fetch(q->sym1, f0);
 		fetch(q->sym2, f1);
+		dest = target(q->sym3, o0);
 		out << "\t\t" << "fcmps" << "\t" << "%f0,%f1" << endl;
 		out << "\t\t" << "nop" << endl;
 		out << "\t\t" << "fbe,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
+		out << "\t\t" << "mov" << "\t" << "0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		out << "\t\t" << "mov" << "\t" << "1,"
+		    << reg[static_cast<int>(dest)] << endl;
 		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_ine:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "cmp" << "\t" << "%o0,%o1" << endl;
-		out << "\t\t" << "be,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "xor" << "\t" << reg[static_cast<int>(src1)]
+		    << "," << reg[static_cast<int>(src2)] << ",%o2" << endl;
+		out << "\t\t" << "subcc" << "\t" << "%g0,%o2,%g0" << endl;
+		out << "\t\t" << "addx" << "\t" << "%g0,0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rlt:
 		label = sym_tab->get_next_label();
 		fetch(q->sym1, f0);
 		fetch(q->sym2, f1);
+		dest = target(q->sym3, o0);
 		out << "\t\t" << "fcmpes" << "\t" << "%f0,%f1" << endl;
 		out << "\t\t" << "nop" << endl;
 		out << "\t\t" << "fbuge,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
+		out << "\t\t" << "mov" << "\t" << "0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		out << "\t\t" << "mov" << "\t" << "1,"
+		    << reg[static_cast<int>(dest)] << endl;
 		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_ilt:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "cmp" << "\t" << "%o0,%o1" << endl;
-		out << "\t\t" << "bge,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		less_than(src1, src2, dest);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rgt:
 		label = sym_tab->get_next_label();
 		fetch(q->sym1, f0);
 		fetch(q->sym2, f1);
+		dest = target(q->sym3, o0);
 		out << "\t\t" << "fcmpes" << "\t" << "%f0,%f1" << endl;
 		out << "\t\t" << "nop" << endl;
 		out << "\t\t" << "fbule,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
+		out << "\t\t" << "mov" << "\t" << "0,"
+		    << reg[static_cast<int>(dest)] << endl;
+		out << "\t\t" << "mov" << "\t" << "1,"
+		    << reg[static_cast<int>(dest)] << endl;
 		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_igt:
-		label = sym_tab->get_next_label();
-		fetch(q->sym1, o0);
-		fetch(q->sym2, o1);
-		out << "\t\t" << "cmp" << "\t" << "%o0,%o1" << endl;
-		out << "\t\t" << "ble,a" << "\t" << "L" << label << endl;
-		out << "\t\t" << "mov" << "\t" << "0,%o0" << endl;
-		out << "\t\t" << "mov" << "\t" << "1,%o0" << endl;
-		out << "L" << label << ":" << endl;
-		store(o0, q->sym3);
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym2, o1);
+		dest = target(q->sym3, o0);
+		less_than(src2, src1, dest);
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rstore:
 	    case q_istore:
-		fetch(q->sym1, o0);
-		fetch(q->sym3, o1);
-		out << "\t\t" << "st" << "\t" << "%o0,[%o1]" << endl;
+		src1 = source(q->sym1, o0);
+		src2 = source(q->sym3, o1);
+		out << "\t\t" << "st" << "\t" << reg[static_cast<int>(src1)]
+		    << ",[" << reg[static_cast<int>(src2)] << "]" << endl;
 		break;
 		
 	    case q_rassign:
 	    case q_iassign:
-		fetch(q->sym1, o0);
-		store(o0, q->sym3);
+		// Fetching straight into the register of the variable assigned,
+		// if it has one, leaves store() nothing to do.
+		src1 = source(q->sym1, target(q->sym3, o0));
+		store(src1, q->sym3);
 		break;
 		
 	    case q_param:
@@ -531,6 +1012,25 @@ void code_generator::expand(quad_list *q_list) {
 		    label = sym->get_function_symbol()->label_nr;
 		for (int i = 0; i < q->int2; ++i)
 		    fetch(args_sym[nr_args - i - 1], i);
+		if(is_tail_call(q, ql_iterator, q_list->last_label)) {
+		    // Leave our own frame first, so the callee's frame takes
+		    // its place and it returns straight to our caller. The
+		    // arguments must be moved to where the restore leaves
+		    // them, and the display register put back the way our
+		    // epilogue would have done it.
+		    for (int i = 0; i < q->int2; ++i)
+			out << "\t\t" << "mov" << "\t%o" << i << ",%i" << i
+			    << endl;
+		    if(saves_display)
+			out << "\t\t" << "ld" << "\t[%fp" << std::showpos
+			    << DISPLAY_REG_OFFSET << std::noshowpos << "],%g"
+			    << env->level + 1 << endl;
+		    out << "\t\t" << "ba" << "\tL" << label
+			<< "\t! " << sym_tab->pool_lookup(sym->id) << endl
+			<< "\t\t" << "restore" << endl;
+		    nr_args -= q->int2;
+		    break;
+		}
 		out << "\t\t" << "call" << "\tL" << label
 		    << "\t! " << sym_tab->pool_lookup(sym->id) << endl
 		    << "\t\t" << "nop" << endl;
@@ -541,26 +1041,50 @@ void code_generator::expand(quad_list *q_list) {
 		
 	    case q_rreturn:
 	    case q_ireturn:
+		// A leaf routine returns in its caller's window, where the
+		// result is expected in %o0, and has no epilogue to jump to.
+		if(leaf) {
+		    fetch(q->sym2, o0);
+		    out << "\t\t" << "retl" << endl;
+		    out << "\t\t" << "nop" << endl;
+		    break;
+		}
 		fetch(q->sym2, i0);
 		out << "\t\t" << "ba" << "\t" << "L" << q->int1 << endl;
 		out << "\t\t" << "nop" << endl;
 		break;
 		
 	    case q_lindex:
-		fetch(q->sym2, o1);
+		src2 = source(q->sym2, o1);
 		array_address(q->sym1, o0);
-		out << "\t\t" << "sll" << "\t" << "%o1,2,%o1" << endl;
-		out << "\t\t" << "add" << "\t" << "%o0,%o1,%o0" << endl;
-		store(o0, q->sym3);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "sll" << "\t" << reg[static_cast<int>(src2)]
+		    << ",2,%o1" << endl;
+		out << "\t\t" << "add" << "\t" << "%o0,%o1,"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_rrindex:
 	    case q_irindex:
-		fetch(q->sym2, o1);
+		src2 = source(q->sym2, o1);
 		array_address(q->sym1, o0);
-		out << "\t\t" << "sll" << "\t" << "%o1,2,%o1" << endl;
-		out << "\t\t" << "ld" << "\t" << "[%o0+%o1],%o0" << endl;
-		store(o0, q->sym3);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "sll" << "\t" << reg[static_cast<int>(src2)]
+		    << ",2,%o1" << endl;
+		out << "\t\t" << "ld" << "\t" << "[%o0+%o1],"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
+		break;
+
+	    case q_rfetch:
+	    case q_ifetch:
+		src1 = source(q->sym1, o0);
+		dest = target(q->sym3, o0);
+		out << "\t\t" << "ld" << "\t" << "["
+		    << reg[static_cast<int>(src1)] << "],"
+		    << reg[static_cast<int>(dest)] << endl;
+		store(dest, q->sym3);
 		break;
 		
 	    case q_itor:
@@ -570,17 +1094,76 @@ void code_generator::expand(quad_list *q_list) {
 		break;
 		
 	    case q_jmp:
+		if(leaf && q->int1 == q_list->last_label) {
+		    out << "\t\t" << "retl" << endl;
+		    out << "\t\t" << "nop" << endl;
+		    break;
+		}
 		out << "\t\t" << "ba" << "\t" << "L" << q->int1 << endl;
 		out << "\t\t" << "nop" << endl;
 		break;
 		
 	    case q_jmpf:
-		fetch(q->sym2, o0);
-		out << "\t\t" << "tst" << "\t" << "%o0" << endl;	
+		src1 = source(q->sym2, o0);
+		out << "\t\t" << "tst" << "\t" << reg[static_cast<int>(src1)]
+		    << endl;
 		out << "\t\t" << "be" << "\t" << "L" << q->int1 << endl;
 		out << "\t\t" << "nop" << endl;
 		break;
 		
+	    case q_jmpt:
+		src1 = source(q->sym2, o0);
+		out << "\t\t" << "tst" << "\t" << reg[static_cast<int>(src1)]
+		    << endl;
+		out << "\t\t" << "bne" << "\t" << "L" << q->int1 << endl;
+		out << "\t\t" << "nop" << endl;
+		break;
+		
+	    case q_jieq:
+	    case q_jine:
+	    case q_jilt:
+	    case q_jige:
+	    case q_jigt:
+	    case q_jile:
+		// A small constant can be compared with directly.
+		src1 = source(q->sym1, o0);
+		if(is_small_constant(q->sym2))
+		    out << "\t\t" << "cmp" << "\t"
+			<< reg[static_cast<int>(src1)] << ","
+			<< sym_tab->get_symbol(q->sym2)->
+			       get_constant_symbol()->const_value.ival << endl;
+		else {
+		    src2 = source(q->sym2, o1);
+		    out << "\t\t" << "cmp" << "\t"
+			<< reg[static_cast<int>(src1)] << ","
+			<< reg[static_cast<int>(src2)] << endl;
+		}
+		out << "\t\t" << branch_for(q->op_code) << "\t" << "L"
+		    << q->int3 << endl;
+		out << "\t\t" << "nop" << endl;
+		break;
+
+	    case q_jreq:
+	    case q_jrne:
+	    case q_jrlt:
+	    case q_jrge:
+	    case q_jrgt:
+	    case q_jrle:
+		// As for the relations above, fcmpes is used for the
+		// orderings, and the float branch mustn't come right after
+		// the compare.
+		fetch(q->sym1, f0);
+		fetch(q->sym2, f1);
+		out << "\t\t"
+		    << (q->op_code == q_jreq || q->op_code == q_jrne ?
+			"fcmps" : "fcmpes")
+		    << "\t" << "%f0,%f1" << endl;
+		out << "\t\t" << "nop" << endl;
+		out << "\t\t" << branch_for(q->op_code) << "\t" << "L"
+		    << q->int3 << endl;
+		out << "\t\t" << "nop" << endl;
+		break;
+		
 	    case q_labl:
 		// We handled this one above already.
 		break;
@@ -598,3 +1181,298 @@ void code_generator::expand(quad_list *q_list) {
     // Flush the generated code to file.
     out << flush;
 }
+
+
+
+/* The code for a routine is collected in out, and these methods fill the
+   delay slots in it before it is written to the file. A SPARC branch or
+   call always executes the instruction after it (the delay slot) before
+   the jump takes effect, which is why expand() puts a nop after each of
+   them. Such a nop can be replaced by:
+     the instruction before the branch, if the branch doesn't depend on
+     it. A conditional branch depends on the cmp or tst before it, so for
+     those it is the instruction before that one which is moved, if the
+     cmp doesn't read what it writes. The nop fcmps needs before a float
+     branch is filled the same way.
+     a copy of the first instruction at the branch target, if nothing can
+     be moved there. The branch is changed to go to a new label after that
+     instruction, and a conditional one is made annulling (,a), so that
+     the copy is only executed if the branch is taken.
+   We work on the text of the lines, where instructions are indented with
+   two tabs, comments with one and labels not at all. */
+
+/* Copy the mnemonic of an instruction into buf, which should have room for
+   16 characters. */
+static void get_mnemonic(const char *line, char *buf) {
+    int i = 0;
+    for(line += 2; *line != '\0' && *line != '\t' && i < 15; line++)
+	buf[i++] = *line;
+    buf[i] = '\0';
+}
+
+
+/* Copy operand number n (from 0) of an instruction into buf, which should
+   have room for 32 characters. Returns 0 if there is no such operand. */
+static int get_operand(const char *line, int n, char *buf) {
+    line = strchr(line + 2, '\t');
+    if(line == NULL)
+	return 0;
+    line++;
+    for(; n > 0; n--) {
+	line = strpbrk(line, ",\t");
+	if(line == NULL || *line == '\t')
+	    return 0;
+	line++;
+    }
+    int i = 0;
+    for(; *line != '\0' && *line != ',' && *line != '\t' && i < 31; line++)
+	buf[i++] = *line;
+    buf[i] = '\0';
+    return i > 0;
+}
+
+
+static int is_instruction(const char *line) {
+    return line != NULL && line[0] == '\t' && line[1] == '\t';
+}
+
+
+static int is_label(const char *line) {
+    return line != NULL && line[0] == 'L';
+}
+
+
+static int is_branch(const char *line) {
+    char m[16];
+    get_mnemonic(line, m);
+    return m[0] == 'b' || (m[0] == 'f' && m[1] == 'b') ||
+	strcmp(m, "call") == 0 || strcmp(m, "ret") == 0 ||
+	strcmp(m, "retl") == 0 || strcmp(m, "jmp") == 0 ||
+	strcmp(m, "jmpl") == 0;
+}
+
+
+static int is_float_compare(const char *line) {
+    char m[16];
+    get_mnemonic(line, m);
+    return strcmp(m, "fcmps") == 0 || strcmp(m, "fcmpes") == 0;
+}
+
+
+static int sets_condition_codes(const char *line) {
+    char m[16];
+    get_mnemonic(line, m);
+    int len = strlen(m);
+    return strcmp(m, "cmp") == 0 || strcmp(m, "tst") == 0 ||
+	(len > 2 && strcmp(m + len - 2, "cc") == 0);
+}
+
+
+static int reads_condition_codes(const char *line) {
+    char m[16];
+    get_mnemonic(line, m);
+    return strncmp(m, "addx", 4) == 0 || strncmp(m, "subx", 4) == 0;
+}
+
+
+/* Returns 1 if an instruction may be put in a delay slot. It mustn't be a
+   branch itself, nor anything whose timing matters, and a set must be
+   small enough to be a single instruction. */
+static int is_movable(const char *line) {
+    char m[16], op[32];
+    if(!is_instruction(line) || is_branch(line) || is_float_compare(line))
+	return 0;
+    get_mnemonic(line, m);
+    if(strcmp(m, "nop") == 0 || strcmp(m, "save") == 0 ||
+       strcmp(m, "restore") == 0 || strcmp(m, "wr") == 0 ||
+       strcmp(m, "rd") == 0)
+	return 0;
+    if(strcmp(m, "set") == 0) {
+	char *end;
+	if(!get_operand(line, 0, op))
+	    return 0;
+	long value = strtol(op, &end, 10);
+	return *end == '\0' && value >= -4096 && value < 4096;
+    }
+    return 1;
+}
+
+
+/* Returns 1 if an instruction reads a register written by another. Both
+   the register and the operands are compared as text, which is enough for
+   the operands we generate. */
+static int depends_on(const char *reader, const char *writer) {
+    char m[16], dest[32], op[32];
+    get_mnemonic(writer, m);
+    if(strcmp(m, "st") == 0)
+	return 0;
+    int n = 0;
+    while(get_operand(writer, n + 1, dest))
+	n++;
+    if(!get_operand(writer, n, dest))
+	return 0;
+    for(n = 0; get_operand(reader, n, op); n++)
+	if(strstr(op, dest) != NULL)
+	    return 1;
+    return 0;
+}
+
+
+/* Split the code collected in out into lines. */
+void code_generator::split_lines() {
+    string code = out.str();
+    const char *p = code.c_str();
+    out.str("");
+
+    nr_lines = 0;
+    while(*p != '\0') {
+	const char *end = strchr(p, '\n');
+	int len = (end == NULL ? strlen(p) : end - p);
+	if(nr_lines == max_lines) {
+	    asm_line *tmp = new asm_line[2 * max_lines];
+	    for(int i = 0; i < nr_lines; i++)
+		tmp[i] = lines[i];
+	    delete[] lines;
+	    lines = tmp;
+	    max_lines *= 2;
+	}
+	lines[nr_lines].text = new char[len + 1];
+	strncpy(lines[nr_lines].text, p, len);
+	lines[nr_lines].text[len] = '\0';
+	lines[nr_lines].label_after = -1;
+	nr_lines++;
+	p += len;
+	if(*p == '\n')
+	    p++;
+    }
+}
+
+
+/* Return the line with a label, or -1 if it isn't in this routine. */
+int code_generator::find_label(int label) {
+    for(int i = 0; i < nr_lines; i++)
+	if(is_label(lines[i].text) && atoi(lines[i].text + 1) == label &&
+	   strchr(lines[i].text, ':') != NULL)
+	    return i;
+    return -1;
+}
+
+
+/* Return the instruction before a line, or -1 if there is a label in
+   between, so that it may be reached some other way. */
+int code_generator::previous_instruction(int line) {
+    for(int i = line - 1; i >= 0; i--) {
+	if(is_label(lines[i].text))
+	    return -1;
+	if(is_instruction(lines[i].text))
+	    return i;
+    }
+    return -1;
+}
+
+
+/* Try to fill the nop at line slot, after the branch (or fcmps) at line
+   branch, with an instruction from before it. Returns 1 if it worked. */
+int code_generator::fill_from_above(int slot, int branch) {
+    char m[16];
+    int test = -1;      // The cmp, tst or fcmps the branch depends on.
+
+    get_mnemonic(lines[branch].text, m);
+    if(is_float_compare(lines[branch].text))
+	test = branch;
+    else if(m[0] == 'b' && strcmp(m, "ba") != 0) {
+	test = previous_instruction(branch);
+	if(test < 0 || !sets_condition_codes(lines[test].text))
+	    return 0;
+    } else if(strcmp(m, "ba") != 0 && strcmp(m, "call") != 0 &&
+	      strcmp(m, "retl") != 0)
+	return 0;
+
+    int from = previous_instruction(test >= 0 ? test : branch);
+    if(from < 0 || !is_movable(lines[from].text))
+	return 0;
+    if(test >= 0 && (depends_on(lines[test].text, lines[from].text) ||
+		     sets_condition_codes(lines[from].text) ||
+		     reads_condition_codes(lines[from].text)))
+	return 0;
+    // It mustn't be in the delay slot of another branch.
+    int before = previous_instruction(from);
+    if(before >= 0 && is_branch(lines[before].text))
+	return 0;
+
+    delete[] lines[slot].text;
+    lines[slot].text = lines[from].text;
+    lines[from].text = NULL;
+    return 1;
+}
+
+
+/* Try to fill the nop at line slot, after the branch at line branch, with
+   the instruction at the branch target. Returns 1 if it worked. */
+int code_generator::fill_from_target(int slot, int branch) {
+    char m[16], op[32];
+
+    get_mnemonic(lines[branch].text, m);
+    if((m[0] != 'b' && strncmp(m, "fb", 2) != 0) ||
+       strchr(m, ',') != NULL || !get_operand(lines[branch].text, 0, op) ||
+       op[0] != 'L')
+	return 0;
+    int label = find_label(atoi(op + 1));
+    if(label < 0)
+	return 0;
+
+    int target = label + 1;
+    while(target < nr_lines && !is_instruction(lines[target].text))
+	target++;
+    if(target == nr_lines || !is_movable(lines[target].text))
+	return 0;
+
+    if(lines[target].label_after < 0)
+	lines[target].label_after = sym_tab->get_next_label();
+    char *text = new char[strlen(m) + 32];
+    sprintf(text, "\t\t%s%s\tL%d", m, (strcmp(m, "ba") == 0 ? "" : ",a"),
+	    lines[target].label_after);
+    delete[] lines[branch].text;
+    lines[branch].text = text;
+
+    delete[] lines[slot].text;
+    lines[slot].text = new char[strlen(lines[target].text) + 1];
+    strcpy(lines[slot].text, lines[target].text);
+    return 1;
+}
+
+
+/* Fill the delay slots in the code collected in out, and write it to the
+   file. All slots are first filled from above where possible, so that the
+   instructions copied from branch targets stay where they are. */
+void code_generator::fill_delay_slots() {
+    int i, branch;
+
+    split_lines();
+    for(i = 0; i < nr_lines; i++)
+	if(is_instruction(lines[i].text) &&
+	   strcmp(lines[i].text, "\t\tnop") == 0) {
+	    branch = previous_instruction(i);
+	    if(branch >= 0 && (is_branch(lines[branch].text) ||
+			       is_float_compare(lines[branch].text)))
+		fill_from_above(i, branch);
+	}
+    for(i = 0; i < nr_lines; i++)
+	if(is_instruction(lines[i].text) &&
+	   strcmp(lines[i].text, "\t\tnop") == 0) {
+	    branch = previous_instruction(i);
+	    if(branch >= 0 && is_branch(lines[branch].text))
+		fill_from_target(i, branch);
+	}
+
+    for(i = 0; i < nr_lines; i++) {
+	if(lines[i].text != NULL) {
+	    object_file << lines[i].text << endl;
+	    delete[] lines[i].text;
+	}
+	if(lines[i].label_after >= 0)
+	    object_file << "L" << lines[i].label_after << ":" << endl;
+    }
+    nr_lines = 0;
+    object_file << flush;
+}
@@ -3,6 +3,7 @@
 
 
 #include <fstream>
+#include <sstream>
 using namespace std;
 
 
@@ -22,6 +23,42 @@ const register_type i0 = 6;
 const register_type f0 = 7;
 const register_type f1 = 8;
 const register_type f2 = 9;
+const register_type l1 = 10;
+const register_type l2 = 11;
+const register_type l3 = 12;
+const register_type l4 = 13;
+const register_type l5 = 14;
+const register_type l6 = 15;
+const register_type l7 = 16;
+const register_type i1 = 17;
+const register_type i2 = 18;
+const register_type i3 = 19;
+const register_type i4 = 20;
+const register_type i5 = 21;
+const int NR_REGISTERS = 22;
+
+/* The registers the quad optimizer may keep integer variables and
+   temporaries in (see the end of quadopt.cc). The symbol's reg field is an
+   index into this table. They all survive calls, since the callee's save
+   gives it registers of its own. %l0 is left out, since we use it for
+   large offsets and constants, and so are %i6 and %i7. The arguments
+   arrive in the %i registers, but the prologue stores them before anything
+   else is done, and %i0 is only set to the result of a function on its
+   way out. */
+const int NR_REGISTER_VARIABLES = 13;
+const register_type register_variables[NR_REGISTER_VARIABLES] = {
+    l1, l2, l3, l4, l5, l6, l7, i1, i2, i3, i4, i5, i0
+};
+
+/* The registers used instead by a leaf routine, which doesn't save its
+   caller's registers and so may only use the %o registers. %o0 and %o1
+   are left for fetching constants and variables of enclosing routines
+   into, and the quad optimizer only makes routines leaves if they don't
+   need anything else. */
+const int NR_LEAF_REGISTERS = 4;
+const register_type leaf_registers[NR_LEAF_REGISTERS] = {
+    o2, o3, o4, o5
+};
 
 
 // The old display register is stored at [%fp+DISPLAY_REG_OFFSET].
@@ -33,6 +70,14 @@ const int FIRST_ARG_OFFSET = 68;
 // 16*4 (dump space) + 4 (old display register) + 6*4 (args) = 92.
 const int MIN_FRAME_SIZE = 92;
 
+// The variables of the main program are kept in .bss instead of its stack
+// frame, so that they are reached the same way however large they are.
+// %g1, the display register of their level, points at GLOBALS_LABEL just
+// after them for the whole run, the way %fp points just after the
+// variables of a routine.
+const int GLOBAL_LEVEL = 1;
+const char GLOBALS_LABEL[] = "globals";
+
 // Maximum number of formal parameters allowed. 
 const int MAX_PARAMETERS = 127;
 const int PARAMETER_STACK_SIZE = 128;
@@ -41,26 +86,100 @@ const int PARAMETER_STACK_SIZE = 128;
 
 /* Prototypes required for code_generator interface (the arguments). */
 class quad_list;
+class quad_list_iterator;
+class quadruple;
 class symbol;
+class parameter_symbol;
+
+
+
+/* One line of assembler code for the routine being generated, kept until
+   its delay slots have been filled. See fill_delay_slots() in codegen.cc. */
+class asm_line {
+public:
+    char *text;              // The line, or NULL if it has been removed.
+    int   label_after;       // Label to put after the line, or -1 if none.
+};
+
+
+
+/* A constant in the literal pool, which real constants are loaded from
+   into the float registers. See fetch() in codegen.cc. */
+class pool_literal {
+public:
+    int bits;                // The value, as an int.
+    int label;               // The label of its word in the pool.
+};
 
 
 
 /* This class generates assembler code for the Sun Sparc architecture. */
 class code_generator {
 private:
-    register_type reg[10][4];                         // Register array.
+    register_type reg[NR_REGISTERS][4];               // Register array.
     
-    ofstream      out;                                // Output file stream.
+    ofstream      object_file;                        // Output file stream.
+    ostringstream out;                                // Code for the routine
+                                                      // being generated.
+    asm_line     *lines;                              // The same, split into
+    int           nr_lines;                           // lines for
+    int           max_lines;                          // fill_delay_slots().
+    pool_literal *literals;                           // The literal pool.
+    int           nr_literals;
+    int           max_literals;
+    int           nr_written;                         // Nr of them written
+                                                      // to the file so far.
+    symbol       *env;                                // The current routine.
+    int           leaf;                               // 1 if it is a leaf
+                                                      // routine.
+    int           saves_display;                      // 1 if it sets its
+                                                      // display register.
+    char          display_name[8];                    // Used by
+                                                      // frame_register().
     
     int  align(int);                                  // Align a stack frame.
     void prologue(symbol *);                          // Initialize new env.
     void epilogue(symbol *);                          // Leave env.
+    void move_leaf_arguments(parameter_symbol *);     // %o regs -> regs of
+                                                      // a leaf's params.
     void expand(quad_list *q);                        // Quadlist -> assembler.
     void find(sym_index, int *, int *);               // Get variable/parameter
                                                       // level & offset.
+    const char *frame_register(int);                  // %fp or display reg
+                                                      // of a level.
     void fetch(sym_index, const register_type);       // memory -> register.
     void store(const register_type, sym_index);       // register -> memory.
+    register_type register_of(sym_index);             // Register holding a
+                                                      // variable, or -1.
+    register_type source(sym_index, const register_type); // Register to read
+                                                      // a symbol from, after
+                                                      // fetching it into the
+                                                      // second arg if needed.
+    register_type target(sym_index, const register_type); // Register to
+                                                      // compute a symbol in
+                                                      // before store().
     void array_address(sym_index, const register_type); // get array base addr.
+    int  literal_label(int);                          // Label of a constant
+                                                      // in the pool.
+    void write_literals();                            // Pool -> file.
+    void write_globals(int);                          // Main's variables ->
+                                                      // .bss.
+    void divide(const register_type, const register_type, // V8 sdiv of
+		const register_type);                 // arg 1 by arg 2.
+    void less_than(const register_type,               // 1 if arg 1 < arg 2,
+		   const register_type,               // without a branch.
+		   const register_type);
+    void split_lines();                               // out -> lines.
+    int  find_label(int);                             // Line of a label.
+    int  previous_instruction(int);                   // Line before, or -1.
+    int  fill_from_above(int, int);                   // Fill a slot with
+                                                      // the code before it.
+    int  fill_from_target(int, int);                  // Fill a slot with
+                                                      // the branch target.
+    void fill_delay_slots();                          // Remove nops.
+    int  is_tail_call(quadruple *, quad_list_iterator *, int); // Args: call,
+                                                      // its position, the
+                                                      // routine's end label.
     
 public:
     // Constructor. Arg = filename of assembler outfile.
@@ -0,0 +1,612 @@
+#include <iostream>
+#include "dataflow.hh"
+
+using namespace std;
+
+
+/* Nr of bits in a word of a bit_set. */
+const int BITS_PER_WORD = 8 * sizeof(unsigned int);
+
+
+
+/*****************************
+ *** METHODS FOR BIT SETS  ***
+ *****************************/
+
+
+/* The bit_set constructor. A new set is empty. */
+bit_set::bit_set(int s) :
+    size(s)
+{
+    nr_words = (size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    if(nr_words == 0)
+	nr_words = 1;
+    bits = new unsigned int[nr_words];
+    clear();
+}
+
+
+void bit_set::add(int i) {
+    bits[i / BITS_PER_WORD] |= 1u << (i % BITS_PER_WORD);
+}
+
+
+void bit_set::remove(int i) {
+    bits[i / BITS_PER_WORD] &= ~(1u << (i % BITS_PER_WORD));
+}
+
+
+int bit_set::member(int i) {
+    return (bits[i / BITS_PER_WORD] >> (i % BITS_PER_WORD)) & 1;
+}
+
+
+void bit_set::clear() {
+    for(int i = 0; i < nr_words; i++)
+	bits[i] = 0;
+}
+
+
+/* Note that the bits above size are set too. That doesn't matter, since
+   no set operation can move them into the range in use. */
+void bit_set::fill() {
+    for(int i = 0; i < nr_words; i++)
+	bits[i] = ~0u;
+}
+
+
+void bit_set::copy(bit_set *other) {
+    for(int i = 0; i < nr_words; i++)
+	bits[i] = other->bits[i];
+}
+
+
+int bit_set::unite(bit_set *other) {
+    int changed = 0;
+    for(int i = 0; i < nr_words; i++) {
+	unsigned int old_bits = bits[i];
+	bits[i] |= other->bits[i];
+	if(bits[i] != old_bits)
+	    changed = 1;
+    }
+    return changed;
+}
+
+
+void bit_set::intersect(bit_set *other) {
+    for(int i = 0; i < nr_words; i++)
+	bits[i] &= other->bits[i];
+}
+
+
+void bit_set::subtract(bit_set *other) {
+    for(int i = 0; i < nr_words; i++)
+	bits[i] &= ~other->bits[i];
+}
+
+
+int bit_set::equals(bit_set *other) {
+    for(int i = 0; i < nr_words; i++)
+	if(bits[i] != other->bits[i])
+	    return 0;
+    return 1;
+}
+
+
+
+/*****************************
+ *** SYMBOL CLASSIFICATION ***
+ *****************************/
+
+
+/* Returns 1 if the callee can see the variable at all. */
+static int is_visible(sym_index callee, sym_index sym_p) {
+    if(sym_tab->is_temp_var(sym_p))
+	return 0;
+
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    if(tag != SYM_VAR && tag != SYM_PARAM && tag != SYM_ARRAY)
+	return 0;
+
+    return sym_tab->get_symbol(sym_p)->level <=
+	sym_tab->get_symbol(callee)->level;
+}
+
+
+int may_be_read(sym_index callee, sym_index sym_p) {
+    if(!is_visible(callee, sym_p))
+	return 0;
+    effect_summary *effects = sym_tab->get_effects(callee);
+    return effects == NULL || !effects->is_complete ||
+	effects->may_read(sym_p);
+}
+
+
+int may_be_written(sym_index callee, sym_index sym_p) {
+    if(!is_visible(callee, sym_p))
+	return 0;
+    effect_summary *effects = sym_tab->get_effects(callee);
+    return effects == NULL || !effects->is_complete ||
+	effects->may_write(sym_p);
+}
+
+
+int may_be_accessed(sym_index callee, sym_index sym_p) {
+    return may_be_read(callee, sym_p) || may_be_written(callee, sym_p);
+}
+
+
+int is_scalar_symbol(sym_index sym_p) {
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    return tag == SYM_VAR || tag == SYM_PARAM;
+}
+
+
+
+/**************************
+ *** THE DATAFLOW ENGINE ***
+ **************************/
+
+
+/* The dataflow_problem constructor. Note that the sets can't be allocated
+   until the subclass knows how large they need to be. */
+dataflow_problem::dataflow_problem(flow_graph *g, flow_direction d,
+				   flow_meet m) :
+    cfg(g),
+    direction(d),
+    meet(m),
+    size(0)
+{
+}
+
+
+void dataflow_problem::allocate() {
+    gen = new bit_set *[cfg->nr_blocks];
+    kill = new bit_set *[cfg->nr_blocks];
+    in = new bit_set *[cfg->nr_blocks];
+    out = new bit_set *[cfg->nr_blocks];
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	gen[i] = new bit_set(size);
+	kill[i] = new bit_set(size);
+	in[i] = new bit_set(size);
+	out[i] = new bit_set(size);
+    }
+    boundary = new bit_set(size);
+}
+
+
+/* The iterative solver. Everything is phrased as if the problem was a
+   forward one; for backward problems we simply swap the roles of in and
+   out, and of predecessors and successors. */
+void dataflow_problem::solve() {
+    int backward = (direction == BACKWARD_FLOW);
+    bit_set **before = (backward ? out : in);   // Where the meet goes.
+    bit_set **after = (backward ? in : out);    // Where the result goes.
+    bit_set *tmp = new bit_set(size);
+    int i;
+
+    // Blocks are on the worklist when on_list is 1. We start with all of
+    // them, in an order which makes information flow in the right direction
+    // the first time around.
+    int *worklist = new int[cfg->nr_blocks];
+    char *on_list = new char[cfg->nr_blocks];
+    int first = 0, nr_work = cfg->nr_blocks;
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	worklist[i] = (backward ? cfg->nr_blocks - 1 - i : i);
+	on_list[i] = 1;
+	if(meet == MEET_INTERSECTION)
+	    after[i]->fill();
+	else
+	    after[i]->clear();
+    }
+
+    while(nr_work > 0) {
+	basic_block *b = cfg->blocks[worklist[first]];
+	on_list[b->nr] = 0;
+	first = (first + 1) % cfg->nr_blocks;
+	nr_work--;
+
+	int nr_from = (backward ? b->nr_succ : b->nr_pred);
+	int *from = (backward ? b->succ : b->pred);
+
+	// Blocks where the routine starts (forward) or ends (backward) get
+	// the boundary set.
+	if(nr_from == 0 || (!backward && b->nr == 0))
+	    before[b->nr]->copy(boundary);
+	else {
+	    before[b->nr]->copy(after[from[0]]);
+	    for(i = 1; i < nr_from; i++) {
+		if(meet == MEET_INTERSECTION)
+		    before[b->nr]->intersect(after[from[i]]);
+		else
+		    before[b->nr]->unite(after[from[i]]);
+	    }
+	}
+
+	// after = gen + (before - kill)
+	tmp->copy(before[b->nr]);
+	tmp->subtract(kill[b->nr]);
+	tmp->unite(gen[b->nr]);
+	if(tmp->equals(after[b->nr]))
+	    continue;
+	after[b->nr]->copy(tmp);
+
+	int nr_to = (backward ? b->nr_pred : b->nr_succ);
+	int *to = (backward ? b->pred : b->succ);
+	for(i = 0; i < nr_to; i++)
+	    if(!on_list[to[i]]) {
+		on_list[to[i]] = 1;
+		worklist[(first + nr_work) % cfg->nr_blocks] = to[i];
+		nr_work++;
+	    }
+    }
+
+    delete tmp;
+    delete[] worklist;
+    delete[] on_list;
+}
+
+
+/* Print a set, as a list of its members. */
+void dataflow_problem::print_set(ostream& o, bit_set *set) {
+    o << "{";
+    for(int i = 0; i < size; i++)
+	if(set->member(i)) {
+	    o << " ";
+	    print_member(o, i);
+	}
+    o << " }" << endl;
+}
+
+
+/* By default there's nothing to explain about the set members. */
+void dataflow_problem::print_legend(ostream&) {
+}
+
+
+void dataflow_problem::print(ostream& o, const char *title) {
+    o << title << endl;
+    print_legend(o);
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	int j;
+
+	o << "  Block " << i;
+	if(b->get_label() >= 0)
+	    o << " (L" << b->get_label() << ")";
+	o << "  pred:";
+	for(j = 0; j < b->nr_pred; j++)
+	    o << " " << b->pred[j];
+	o << "  succ:";
+	for(j = 0; j < b->nr_succ; j++)
+	    o << " " << b->succ[j];
+	o << endl;
+
+	o << "    in:  ";
+	print_set(o, in[i]);
+	o << "    out: ";
+	print_set(o, out[i]);
+    }
+    o << endl;
+}
+
+
+
+/******************
+ *** LIVENESS  ***
+ ******************/
+
+
+liveness::liveness(flow_graph *g) :
+    dataflow_problem(g, BACKWARD_FLOW, MEET_UNION)
+{
+    sym_index uses[MAX_QUAD_USES];
+
+    size = MAX_SYM;
+    allocate();
+
+    // Collect all scalars mentioned in the routine. These are the only ones
+    // a call can make live that we care about.
+    symbols = new bit_set(size);
+    for(int i = 0; i < cfg->nr_blocks; i++)
+	for(int j = 0; j < cfg->blocks[i]->nr_quads; j++) {
+	    quadruple *q = cfg->blocks[i]->quads[j];
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++)
+		if(is_scalar_symbol(uses[u]))
+		    symbols->add(uses[u]);
+	    if(q->get_def() != NULL_SYM)
+		symbols->add(q->get_def());
+	}
+
+    compute_local();
+    solve();
+}
+
+
+/* Walk backwards over a quad: the symbol it assigns is not live before it
+   (unless the quad reads it too), and the symbols it reads are. */
+void liveness::step_back(quadruple *q, bit_set *live) {
+    sym_index uses[MAX_QUAD_USES];
+
+    if(q->get_def() != NULL_SYM)
+	live->remove(q->get_def());
+
+    int nr_uses = q->get_uses(uses);
+    for(int u = 0; u < nr_uses; u++)
+	if(is_scalar_symbol(uses[u]))
+	    live->add(uses[u]);
+
+    if(q->op_code == q_call)
+	for(int s = 0; s < size; s++)
+	    if(symbols->member(s) && may_be_read(q->sym1, s))
+		live->add(s);
+}
+
+
+void liveness::compute_local() {
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+
+	// gen is what step_back leaves live when starting from nothing, and
+	// kill is everything assigned in the block.
+	for(int j = b->nr_quads - 1; j >= 0; j--) {
+	    step_back(b->quads[j], gen[i]);
+	    if(b->quads[j]->get_def() != NULL_SYM)
+		kill[i]->add(b->quads[j]->get_def());
+	}
+    }
+
+    // Variables declared outside the routine can be read after it returns.
+    for(int s = 0; s < size; s++)
+	if(symbols->member(s) && !sym_tab->is_temp_var(s) &&
+	   sym_tab->get_symbol(s)->level <= cfg->env->level)
+	    boundary->add(s);
+}
+
+
+void liveness::print_member(ostream& o, int i) {
+    o << sym_tab->pool_lookup(sym_tab->get_symbol_id(i));
+}
+
+
+
+/****************************
+ *** REACHING DEFINITIONS ***
+ ****************************/
+
+
+reaching_definitions::reaching_definitions(flow_graph *g) :
+    dataflow_problem(g, FORWARD_FLOW, MEET_UNION)
+{
+    int i, j;
+
+    // Number the definitions.
+    nr_defs = 0;
+    for(i = 0; i < cfg->nr_blocks; i++)
+	for(j = 0; j < cfg->blocks[i]->nr_quads; j++)
+	    if(cfg->blocks[i]->quads[j]->get_def() != NULL_SYM ||
+	       cfg->blocks[i]->quads[j]->op_code == q_call)
+		nr_defs++;
+
+    defs = new quadruple *[nr_defs];
+    def_block = new int[nr_defs];
+    nr_defs = 0;
+    for(i = 0; i < cfg->nr_blocks; i++)
+	for(j = 0; j < cfg->blocks[i]->nr_quads; j++)
+	    if(cfg->blocks[i]->quads[j]->get_def() != NULL_SYM ||
+	       cfg->blocks[i]->quads[j]->op_code == q_call) {
+		defs[nr_defs] = cfg->blocks[i]->quads[j];
+		def_block[nr_defs] = i;
+		nr_defs++;
+	    }
+
+    size = nr_defs;
+    allocate();
+    compute_local();
+    solve();
+}
+
+
+int reaching_definitions::defines(int d, sym_index sym_p) {
+    if(defs[d]->get_def() == sym_p)
+	return 1;
+    return defs[d]->op_code == q_call && may_be_written(defs[d]->sym1, sym_p);
+}
+
+
+void reaching_definitions::compute_local() {
+    int d = 0;
+
+    if(nr_defs == 0)
+	return;
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(int j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    if(q != defs[d])
+		continue;
+
+	    // An assignment kills all other definitions of the symbol.
+	    sym_index def = q->get_def();
+	    if(def != NULL_SYM)
+		for(int k = 0; k < nr_defs; k++)
+		    if(k != d && defs[k]->get_def() == def) {
+			kill[i]->add(k);
+			gen[i]->remove(k);
+		    }
+
+	    gen[i]->add(d);
+	    d++;
+	    if(d == nr_defs)
+		return;
+	}
+    }
+}
+
+
+void reaching_definitions::print_legend(ostream& o) {
+    o << short_symbols;
+    for(int i = 0; i < nr_defs; i++)
+	o << "  d" << i << ":" << defs[i] << endl;
+    o << long_symbols;
+}
+
+
+void reaching_definitions::print_member(ostream& o, int i) {
+    o << "d" << i;
+    if(defs[i]->get_def() != NULL_SYM)
+	o << "(" << sym_tab->pool_lookup(sym_tab->get_symbol_id(
+					     defs[i]->get_def())) << ")";
+    else
+	o << "(call)";
+}
+
+
+
+/*****************************
+ *** AVAILABLE EXPRESSIONS ***
+ *****************************/
+
+
+/* Returns 1 if a quad is a pure computation of its operands. Loads of
+   constants are left out, since they are always available anyway. */
+static int is_expression(quad_op_type op) {
+    switch(op) {
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_itor:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+
+available_expressions::available_expressions(flow_graph *g) :
+    dataflow_problem(g, FORWARD_FLOW, MEET_INTERSECTION)
+{
+    int i, j, nr_quads = 0;
+
+    for(i = 0; i < cfg->nr_blocks; i++)
+	nr_quads += cfg->blocks[i]->nr_quads;
+
+    // Collect the distinct expressions.
+    exprs = new quadruple *[nr_quads + 1];
+    nr_exprs = 0;
+    for(i = 0; i < cfg->nr_blocks; i++)
+	for(j = 0; j < cfg->blocks[i]->nr_quads; j++) {
+	    quadruple *q = cfg->blocks[i]->quads[j];
+	    if(is_expression(q->op_code) && expression_nr(q) < 0)
+		exprs[nr_exprs++] = q;
+	}
+
+    size = nr_exprs;
+    allocate();
+    compute_local();
+    solve();
+}
+
+
+int available_expressions::expression_nr(quadruple *q) {
+    if(!is_expression(q->op_code))
+	return -1;
+
+    for(int i = 0; i < nr_exprs; i++)
+	if(exprs[i]->op_code == q->op_code && exprs[i]->sym1 == q->sym1 &&
+	   exprs[i]->sym2 == q->sym2)
+	    return i;
+    return -1;
+}
+
+
+int available_expressions::kills(quadruple *q, int e) {
+    quadruple *expr = exprs[e];
+    sym_index def = q->get_def();
+    sym_index uses[MAX_QUAD_USES];
+    int nr_uses = expr->get_uses(uses);
+
+    // Assigning an operand.
+    if(def != NULL_SYM)
+	for(int u = 0; u < nr_uses; u++)
+	    if(uses[u] == def)
+		return 1;
+
+    int is_load = (expr->op_code == q_irindex || expr->op_code == q_rrindex);
+
+    if(q->op_code == q_call) {
+	if(is_load && may_be_written(q->sym1, expr->sym1))
+	    return 1;
+	for(int u = 0; u < nr_uses; u++)
+	    if(may_be_written(q->sym1, uses[u]))
+		return 1;
+    }
+
+    // We don't track which array a store goes to here, so a store kills
+    // all array loads.
+    if((q->op_code == q_istore || q->op_code == q_rstore) && is_load)
+	return 1;
+
+    return 0;
+}
+
+
+void available_expressions::compute_local() {
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(int j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    int e;
+	    int nr = expression_nr(q);
+
+	    for(e = 0; e < nr_exprs; e++)
+		if(kills(q, e)) {
+		    kill[i]->add(e);
+		    gen[i]->remove(e);
+		}
+
+	    // A quad like X := X + 1 computes the expression, but kills it at
+	    // the same time.
+	    if(nr >= 0 && !kills(q, nr)) {
+		gen[i]->add(nr);
+		kill[i]->remove(nr);
+	    }
+	}
+    }
+}
+
+
+void available_expressions::print_legend(ostream& o) {
+    o << short_symbols;
+    for(int i = 0; i < nr_exprs; i++)
+	o << "  e" << i << ":" << exprs[i] << endl;
+    o << long_symbols;
+}
+
+
+void available_expressions::print_member(ostream& o, int i) {
+    o << "e" << i;
+}
@@ -0,0 +1,198 @@
+#ifndef __DATAFLOW_HH__
+#define __DATAFLOW_HH__
+
+#include <iostream>
+#include "symtab.hh"
+#include "quads.hh"
+#include "flowgraph.hh"
+
+using namespace std;
+
+
+/* This file contains a general iterative dataflow engine working on the flow
+   graph of a routine (see flowgraph.hh), and the three classic problems
+   built on it:
+
+     Liveness: which variables may be read before they are written again.
+               Backward, union. Sets of sym_index.
+     Reaching definitions: which assignments may still be what a variable
+               holds. Forward, union. Sets of definition numbers.
+     Available expressions: which computations have already been done on
+               every path, with operands unchanged since. Forward,
+               intersection. Sets of expression numbers.
+
+   The engine only needs a problem to supply gen and kill sets for each
+   block. It then iterates until nothing changes, using a worklist. The
+   optimizer passes only use liveness so far; the other two are printed
+   by the -l flag. */
+
+
+class bit_set;
+class dataflow_problem;
+class liveness;
+class reaching_definitions;
+class available_expressions;
+
+
+
+/* A set of small non-negative integers, kept as a bit vector. Used for sets
+   of sym_index (sized MAX_SYM), definitions and expressions. */
+class bit_set {
+private:
+    unsigned int *bits;
+    int           nr_words;
+
+public:
+    int           size;                  // Largest member + 1.
+
+    bit_set(int);                        // Constructor. Arg == size.
+
+    void          add(int);
+    void          remove(int);
+    int           member(int);
+    void          clear();               // Make the set empty.
+    void          fill();                // Make the set contain everything.
+    void          copy(bit_set *);       // Make the set equal to the arg.
+    int           unite(bit_set *);      // Union. Returns 1 if changed.
+    void          intersect(bit_set *);  // Intersection.
+    void          subtract(bit_set *);   // Set difference.
+    int           equals(bit_set *);
+};
+
+
+
+/* These describe the kind of dataflow problem. */
+enum flow_directions { FORWARD_FLOW, BACKWARD_FLOW };
+typedef enum flow_directions flow_direction;
+
+enum flow_meets { MEET_UNION, MEET_INTERSECTION };
+typedef enum flow_meets flow_meet;
+
+
+
+/* Returns 1 if a call to the callee might read or write the variable. A
+   routine can only see variables declared on its own level or further out,
+   and the same holds for every routine it might call in turn, except those
+   nested inside it (which see the callee's own locals, not ours). So
+   anything declared on a deeper level than the callee is safe. Of the
+   rest, the callee's effect summary (see symtab.hh) tells which ones it
+   actually reads or writes, when it is known. */
+int may_be_accessed(sym_index callee, sym_index sym_p);
+int may_be_read(sym_index callee, sym_index sym_p);
+int may_be_written(sym_index callee, sym_index sym_p);
+
+/* Returns 1 if the symbol is a scalar which the dataflow problems track,
+   ie, a variable, parameter or temporary. */
+int is_scalar_symbol(sym_index sym_p);
+
+
+
+/* The base class of all dataflow problems. */
+class dataflow_problem {
+protected:
+    flow_graph     *cfg;
+    flow_direction  direction;
+    flow_meet       meet;
+
+    // Fill in gen and kill for all blocks, and the boundary set which is
+    // the in set of the first block (forward) or the out set of blocks
+    // leaving the routine (backward).
+    virtual void    compute_local() = 0;
+
+    // Print the name of a set member, and an explanation of the names.
+    virtual void    print_member(ostream&, int) = 0;
+    virtual void    print_legend(ostream&);
+
+    void            print_set(ostream&, bit_set *);
+
+    // Allocate the sets. Called by the subclasses once size is known.
+    void            allocate();
+
+public:
+    int             size;          // Size of the sets.
+    bit_set       **gen;           // Indexed by block number.
+    bit_set       **kill;
+    bit_set       **in;
+    bit_set       **out;
+    bit_set        *boundary;
+
+    dataflow_problem(flow_graph *, flow_direction, flow_meet);
+    virtual ~dataflow_problem() {}
+
+    // Compute in and out for all blocks. The subclass constructors call
+    // this, so a problem is solved as soon as it has been created. Passes
+    // which change the flow graph must create a new one afterwards.
+    void            solve();
+
+    // Print the in and out sets of every block. Arg 2 is a title.
+    void            print(ostream&, const char *);
+};
+
+
+
+/* Liveness of variables, parameters and temporaries. Variables declared
+   outside the routine are considered live when it returns, and a call is
+   considered to read every variable the callee may access. */
+class liveness : public dataflow_problem {
+protected:
+    virtual void    compute_local();
+    virtual void    print_member(ostream&, int);
+
+public:
+    bit_set        *symbols;       // Every scalar in the routine.
+
+    liveness(flow_graph *);
+
+    // Update a set of variables live after a quad to the ones live before.
+    void            step_back(quadruple *, bit_set *);
+};
+
+
+
+/* Reaching definitions. Every quad assigning a scalar is a definition, and
+   a call is a definition of every variable the callee may access. Calls
+   never kill anything, since they might not actually assign. */
+class reaching_definitions : public dataflow_problem {
+protected:
+    virtual void    compute_local();
+    virtual void    print_member(ostream&, int);
+    virtual void    print_legend(ostream&);
+
+public:
+    quadruple     **defs;          // Definition number -> quad.
+    int            *def_block;     // Definition number -> block.
+    int             nr_defs;
+
+    reaching_definitions(flow_graph *);
+
+    // Returns 1 if a definition may assign a symbol.
+    int             defines(int, sym_index);
+};
+
+
+
+/* Available expressions. An expression is a pure computation, identified by
+   its operator and operands. It is killed by any assignment of one of its
+   operands. Array loads are also killed by stores and calls. */
+class available_expressions : public dataflow_problem {
+protected:
+    virtual void    compute_local();
+    virtual void    print_member(ostream&, int);
+    virtual void    print_legend(ostream&);
+
+public:
+    quadruple     **exprs;         // Expression number -> first quad
+                                   // computing it.
+    int             nr_exprs;
+
+    available_expressions(flow_graph *);
+
+    // Return the expression number of a quad, or -1 if it isn't one.
+    int             expression_nr(quadruple *);
+
+    // Returns 1 if the quad kills the expression.
+    int             kills(quadruple *, int);
+};
+
+
+#endif
@@ -0,0 +1,626 @@
+#include <iostream>
+#include "flowgraph.hh"
+
+using namespace std;
+
+
+/* The basic_block constructor. A new block is empty and has no edges. */
+basic_block::basic_block(int n) :
+    nr(n),
+    nr_quads(0),
+    max_quads(BASE_BLOCK_SIZE),
+    nr_succ(0),
+    nr_pred(0),
+    max_pred(MAX_SUCCESSORS),
+    phis(NULL)
+{
+    quads = new quadruple *[max_quads];
+    pred = new int[max_pred];
+}
+
+
+/* The basic_block destructor. The quads are left alone, since they live on
+   in the quad list the flow graph is linearized into. */
+basic_block::~basic_block() {
+    delete[] quads;
+    delete[] pred;
+}
+
+
+/* Add a quad last in the block, growing the quad array if needed. */
+void basic_block::append(quadruple *q) {
+    insert(nr_quads, q);
+}
+
+
+/* Insert a quad so that it ends up at position pos in the block. */
+void basic_block::insert(int pos, quadruple *q) {
+    if(pos < 0 || pos > nr_quads)
+	fatal("basic_block::insert(): position out of range");
+
+    if(nr_quads == max_quads) {
+	quadruple **new_quads = new quadruple *[max_quads * 2];
+	for(int i = 0; i < nr_quads; i++)
+	    new_quads[i] = quads[i];
+	delete[] quads;
+	quads = new_quads;
+	max_quads *= 2;
+    }
+
+    for(int i = nr_quads; i > pos; i--)
+	quads[i] = quads[i - 1];
+    quads[pos] = q;
+    nr_quads++;
+}
+
+
+/* Remove the quad at position pos. The quad itself is not deleted, since
+   a pass might want to put it somewhere else. */
+void basic_block::remove(int pos) {
+    if(pos < 0 || pos >= nr_quads)
+	fatal("basic_block::remove(): position out of range");
+
+    for(int i = pos; i < nr_quads - 1; i++)
+	quads[i] = quads[i + 1];
+    nr_quads--;
+}
+
+
+/* Add a block to the predecessor list. */
+void basic_block::add_pred(int p) {
+    if(nr_pred == max_pred) {
+	int *new_pred = new int[max_pred * 2];
+	for(int i = 0; i < nr_pred; i++)
+	    new_pred[i] = pred[i];
+	delete[] pred;
+	pred = new_pred;
+	max_pred *= 2;
+    }
+    pred[nr_pred++] = p;
+}
+
+
+/* Return the label a block starts with, or -1 if it doesn't have one. Since
+   a new block is started at every label, only the first quad can be one. */
+int basic_block::get_label() {
+    if(nr_quads > 0 && quads[0]->op_code == q_labl)
+	return quads[0]->int1;
+    return -1;
+}
+
+
+/* Return the last quad of the block, or NULL if the block is empty. */
+quadruple *basic_block::get_last() {
+    if(nr_quads == 0)
+	return NULL;
+    return quads[nr_quads - 1];
+}
+
+
+
+/* Returns 1 if a quad ends a basic block, ie, if the next quad can be
+   reached from somewhere else than this quad. */
+static int ends_block(quadruple *q) {
+    switch(q->op_code) {
+    case q_jmp:
+    case q_jmpf:
+    case q_jmpt:
+    case q_ireturn:
+    case q_rreturn:
+    case q_jieq:
+    case q_jine:
+    case q_jilt:
+    case q_jige:
+    case q_jigt:
+    case q_jile:
+    case q_jreq:
+    case q_jrne:
+    case q_jrlt:
+    case q_jrge:
+    case q_jrgt:
+    case q_jrle:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+
+
+/* The flow_graph constructor. We walk the quad list once, starting a new
+   block at each label and after each jump. */
+flow_graph::flow_graph(quad_list *q_list, symbol *e) :
+    max_blocks(BASE_BLOCK_SIZE),
+    nr_blocks(0),
+    last_label(q_list->last_label),
+    env(e)
+{
+    blocks = new basic_block *[max_blocks];
+
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quadruple *q = ql_iterator->get_current();
+    basic_block *current = NULL;
+
+    while(q != NULL) {
+	if(current == NULL ||
+	   (q->op_code == q_labl && current->nr_quads > 0))
+	    current = insert_block(nr_blocks);
+
+	current->append(q);
+
+	if(ends_block(q))
+	    current = NULL;
+
+	q = ql_iterator->get_next();
+    }
+    delete ql_iterator;
+
+    // Make sure there always is at least one block, so the passes never
+    // have to worry about an empty routine.
+    if(nr_blocks == 0)
+	insert_block(0);
+
+    compute_edges();
+}
+
+
+/* The flow_graph destructor. Like the blocks, it leaves the quads alone. */
+flow_graph::~flow_graph() {
+    for(int i = 0; i < nr_blocks; i++)
+	delete blocks[i];
+    delete[] blocks;
+}
+
+
+
+/* Return the number of the block starting with a given label. */
+int flow_graph::find_label(int label) {
+    for(int i = 0; i < nr_blocks; i++)
+	if(blocks[i]->get_label() == label)
+	    return i;
+
+    fatal("flow_graph::find_label(): jump to unknown label");
+    return -1;
+}
+
+
+
+/* (Re)compute the edges of the flow graph. The blocks are numbered after
+   their position first, so passes can freely move blocks around before
+   calling this method. */
+void flow_graph::compute_edges() {
+    int max_label = last_label;
+    int i;
+
+    for(i = 0; i < nr_blocks; i++) {
+	blocks[i]->nr = i;
+	blocks[i]->nr_succ = 0;
+	blocks[i]->nr_pred = 0;
+	if(blocks[i]->get_label() > max_label)
+	    max_label = blocks[i]->get_label();
+    }
+
+    // A table from label to block number, so we don't have to search for
+    // every jump we find.
+    int *label_block = new int[max_label + 1];
+    for(i = 0; i <= max_label; i++)
+	label_block[i] = -1;
+    for(i = 0; i < nr_blocks; i++)
+	if(blocks[i]->get_label() >= 0)
+	    label_block[blocks[i]->get_label()] = i;
+
+    for(i = 0; i < nr_blocks; i++) {
+	basic_block *b = blocks[i];
+	quadruple *last = b->get_last();
+	int target = -1;
+	int falls_through = 1;
+
+	if(last != NULL) {
+	    switch(last->op_code) {
+	    case q_jmp:
+	    case q_ireturn:
+	    case q_rreturn:
+		falls_through = 0;
+		target = last->int1;
+		break;
+	    case q_jmpf:
+	    case q_jmpt:
+		target = last->int1;
+		break;
+	    case q_jieq:
+	    case q_jine:
+	    case q_jilt:
+	    case q_jige:
+	    case q_jigt:
+	    case q_jile:
+	    case q_jreq:
+	    case q_jrne:
+	    case q_jrlt:
+	    case q_jrge:
+	    case q_jrgt:
+	    case q_jrle:
+		target = last->int3;
+		break;
+	    default:
+		break;
+	    }
+	}
+
+	if(falls_through && i + 1 < nr_blocks)
+	    b->succ[b->nr_succ++] = i + 1;
+
+	if(target >= 0) {
+	    if(target > max_label || label_block[target] < 0)
+		fatal("flow_graph::compute_edges(): jump to unknown label");
+	    // A conditional jump to the very next block only has one
+	    // successor.
+	    if(b->nr_succ == 0 || b->succ[0] != label_block[target])
+		b->succ[b->nr_succ++] = label_block[target];
+	}
+
+	for(int s = 0; s < b->nr_succ; s++)
+	    blocks[b->succ[s]]->add_pred(i);
+    }
+
+    delete[] label_block;
+}
+
+
+
+/* Create a new, empty block and place it at position pos. The blocks after
+   it are moved down one step. Note that the edges are not updated. */
+basic_block *flow_graph::insert_block(int pos) {
+    if(pos < 0 || pos > nr_blocks)
+	fatal("flow_graph::insert_block(): position out of range");
+
+    if(nr_blocks == max_blocks) {
+	basic_block **new_blocks = new basic_block *[max_blocks * 2];
+	for(int i = 0; i < nr_blocks; i++)
+	    new_blocks[i] = blocks[i];
+	delete[] blocks;
+	blocks = new_blocks;
+	max_blocks *= 2;
+    }
+
+    for(int i = nr_blocks; i > pos; i--) {
+	blocks[i] = blocks[i - 1];
+	blocks[i]->nr = i;
+    }
+    blocks[pos] = new basic_block(pos);
+    nr_blocks++;
+
+    return blocks[pos];
+}
+
+
+
+/* Remove unreachable blocks, such as code following a return statement.
+   The block containing the last label is always kept, since the code
+   generator places the epilogue right after it. */
+int flow_graph::remove_unreachable() {
+    int *reached = new int[nr_blocks];
+    int *work = new int[nr_blocks];
+    int nr_work = 0;
+    int i, removed = 0;
+
+    for(i = 0; i < nr_blocks; i++)
+	reached[i] = 0;
+    reached[0] = 1;
+    work[nr_work++] = 0;
+
+    while(nr_work > 0) {
+	basic_block *b = blocks[work[--nr_work]];
+	for(int s = 0; s < b->nr_succ; s++)
+	    if(!reached[b->succ[s]]) {
+		reached[b->succ[s]] = 1;
+		work[nr_work++] = b->succ[s];
+	    }
+    }
+    reached[nr_blocks - 1] = 1;
+
+    int pos = 0;
+    for(i = 0; i < nr_blocks; i++) {
+	if(reached[i])
+	    blocks[pos++] = blocks[i];
+	else
+	    removed = 1;
+    }
+    nr_blocks = pos;
+
+    delete[] reached;
+    delete[] work;
+
+    if(removed)
+	compute_edges();
+    return removed;
+}
+
+
+
+/* Put the blocks back together into a quad list, in block order. */
+quad_list *flow_graph::linearize() {
+    quad_list *q_list = new quad_list(last_label);
+
+    for(int i = 0; i < nr_blocks; i++)
+	for(int j = 0; j < blocks[i]->nr_quads; j++)
+	    (*q_list) += blocks[i]->quads[j];
+
+    return q_list;
+}
+
+
+
+/* Remove jumps to the next non-empty block. A conditional jump there is as
+   useless as an unconditional one, since both ways lead to the same place,
+   so it can go too (the computation of its condition is then left for
+   dead code elimination to remove). In SSA form, the way we came matters
+   if the target has phi nodes, so then the jump is kept. */
+int flow_graph::remove_useless_jumps() {
+    int removed = 0;
+
+    for(int i = 0; i + 1 < nr_blocks; i++) {
+	// Empty blocks in between don't count.
+	int next = i + 1;
+	while(next + 1 < nr_blocks && blocks[next]->nr_quads == 0)
+	    next++;
+
+	quadruple *last = blocks[i]->get_last();
+	if(last != NULL &&
+	   (last->op_code == q_jmp || last->op_code == q_jmpf ||
+	    last->op_code == q_jmpt) &&
+	   last->int1 == blocks[next]->get_label() &&
+	   blocks[next]->phis == NULL) {
+	    blocks[i]->remove(blocks[i]->nr_quads - 1);
+	    removed = 1;
+	}
+    }
+
+    if(removed)
+	compute_edges();
+    return removed;
+}
+
+
+
+/* Insert a preheader before the header of a loop. The preheader gets a label
+   of its own, and jumps into the loop from outside are redirected to it.
+   Since the preheader is placed right before the header, whatever fell
+   through to the header before falls through to the preheader now. That's
+   right if it is outside the loop, but a block inside the loop falling
+   through to the header must be given a jump back to it instead. */
+basic_block *flow_graph::insert_preheader(natural_loop *loop) {
+    basic_block *header = blocks[loop->header];
+    int header_label = header->get_label();
+    int label = sym_tab->get_next_label();
+    int i;
+
+    // Redirect the jumps into the loop.
+    for(i = 0; i < nr_blocks; i++) {
+	quadruple *last = blocks[i]->get_last();
+	if(!loop->body[i] && last != NULL &&
+	   (last->op_code == q_jmp || last->op_code == q_jmpf ||
+	    last->op_code == q_jmpt) &&
+	   last->int1 == header_label)
+	    last->int1 = label;
+    }
+
+    int pos = header->nr;
+    if(pos > 0 && loop->body[pos - 1]) {
+	quadruple *prev = blocks[pos - 1]->get_last();
+	if(prev == NULL || (prev->op_code != q_jmp &&
+			    prev->op_code != q_ireturn &&
+			    prev->op_code != q_rreturn)) {
+	    // The header must have a label, since it has a back edge which
+	    // isn't a fall through edge.
+	    if(header_label < 0)
+		fatal("flow_graph::insert_preheader(): header without label");
+	    insert_block(pos++)->append(
+		new quadruple(q_jmp, header_label, NULL_SYM, NULL_SYM));
+	}
+    }
+
+    basic_block *preheader = insert_block(pos);
+    preheader->append(new quadruple(q_labl, label, NULL_SYM, NULL_SYM));
+    compute_edges();
+    return preheader;
+}
+
+
+
+/* Insert an empty first block if the first block is the target of a jump,
+   such as the top of a while loop that starts the routine. */
+void flow_graph::make_entry_block() {
+    if(blocks[0]->nr_pred == 0)
+	return;
+    insert_block(0);
+    compute_edges();
+}
+
+
+
+/***********************
+ *** DOMINATOR TREES ***
+ ***********************/
+
+
+/* Number the blocks in postorder, by a depth first search from block b. The
+   blocks are put in rpo from the end, so it ends up in reverse postorder. */
+void dominator_tree::number_blocks(int b, char *visited) {
+    visited[b] = 1;
+    for(int s = cfg->blocks[b]->nr_succ - 1; s >= 0; s--)
+	if(!visited[cfg->blocks[b]->succ[s]])
+	    number_blocks(cfg->blocks[b]->succ[s], visited);
+    rpo[--nr_rpo] = b;
+}
+
+
+/* Find the closest common dominator of two blocks, by walking up the tree
+   from the one furthest down (ie, latest in reverse postorder) until the
+   two meet. */
+int dominator_tree::intersect(int a, int b) {
+    while(a != b) {
+	while(rpo_nr[a] > rpo_nr[b])
+	    a = idom[a];
+	while(rpo_nr[b] > rpo_nr[a])
+	    b = idom[b];
+    }
+    return a;
+}
+
+
+dominator_tree::dominator_tree(flow_graph *g) :
+    cfg(g)
+{
+    int n = cfg->nr_blocks;
+    int i, j;
+    char *visited = new char[n];
+
+    idom = new int[n];
+    rpo = new int[n];
+    rpo_nr = new int[n];
+    for(i = 0; i < n; i++) {
+	visited[i] = 0;
+	idom[i] = -1;
+	rpo_nr[i] = -1;
+    }
+
+    // number_blocks() fills rpo from the end, so we start with nr_rpo at
+    // the end, and move the result to the start of the array afterwards in
+    // case some blocks were unreachable.
+    nr_rpo = n;
+    number_blocks(0, visited);
+    int first = nr_rpo;
+    nr_rpo = n - first;
+    for(i = 0; i < nr_rpo; i++) {
+	rpo[i] = rpo[first + i];
+	rpo_nr[rpo[i]] = i;
+    }
+
+    // The iteration. The first block is its own dominator while we're at
+    // it, which makes intersect() stop there.
+    idom[0] = 0;
+    int changed = 1;
+    while(changed) {
+	changed = 0;
+	for(i = 1; i < nr_rpo; i++) {
+	    basic_block *b = cfg->blocks[rpo[i]];
+	    int new_idom = -1;
+	    for(j = 0; j < b->nr_pred; j++) {
+		int p = b->pred[j];
+		if(idom[p] < 0)
+		    continue;
+		new_idom = (new_idom < 0 ? p : intersect(p, new_idom));
+	    }
+	    if(idom[b->nr] != new_idom) {
+		idom[b->nr] = new_idom;
+		changed = 1;
+	    }
+	}
+    }
+    idom[0] = -1;
+
+    // Build the child lists.
+    children = new int *[n];
+    nr_children = new int[n];
+    for(i = 0; i < n; i++)
+	nr_children[i] = 0;
+    for(i = 0; i < n; i++)
+	if(idom[i] >= 0)
+	    nr_children[idom[i]]++;
+    for(i = 0; i < n; i++) {
+	children[i] = new int[nr_children[i] + 1];
+	nr_children[i] = 0;
+    }
+    for(i = 0; i < nr_rpo; i++)
+	if(idom[rpo[i]] >= 0)
+	    children[idom[rpo[i]]][nr_children[idom[rpo[i]]]++] = rpo[i];
+
+    delete[] visited;
+}
+
+
+int dominator_tree::dominates(int a, int b) {
+    if(rpo_nr[b] < 0)
+	return 0;
+    while(b >= 0 && b != a)
+	b = idom[b];
+    return b == a;
+}
+
+
+
+/*********************
+ *** NATURAL LOOPS ***
+ *********************/
+
+
+natural_loop::natural_loop(int h, int n) :
+    header(h),
+    nr_body(1)
+{
+    body = new char[n];
+    for(int i = 0; i < n; i++)
+	body[i] = 0;
+    body[h] = 1;
+}
+
+
+/* Find the loops. For each back edge b -> h, we walk the flow graph
+   backwards from b, adding blocks to the loop of h, and stopping at blocks
+   already in it (h is in it from the start). Unreachable blocks are never
+   part of a loop. */
+loop_nest::loop_nest(flow_graph *cfg, dominator_tree *dom) :
+    nr_loops(0)
+{
+    int n = cfg->nr_blocks;
+    int *work = new int[n];
+    int i, j;
+
+    loops = new natural_loop *[n];
+
+    for(i = 0; i < n; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(int s = 0; s < b->nr_succ; s++) {
+	    int h = b->succ[s];
+	    if(!dom->dominates(h, i))
+		continue;
+
+	    natural_loop *loop = NULL;
+	    for(j = 0; j < nr_loops; j++)
+		if(loops[j]->header == h)
+		    loop = loops[j];
+	    if(loop == NULL) {
+		loop = new natural_loop(h, n);
+		loops[nr_loops++] = loop;
+	    }
+
+	    int nr_work = 0;
+	    if(!loop->body[i]) {
+		loop->body[i] = 1;
+		loop->nr_body++;
+		work[nr_work++] = i;
+	    }
+	    while(nr_work > 0) {
+		basic_block *x = cfg->blocks[work[--nr_work]];
+		for(j = 0; j < x->nr_pred; j++)
+		    if(!loop->body[x->pred[j]] &&
+		       dom->rpo_nr[x->pred[j]] >= 0) {
+			loop->body[x->pred[j]] = 1;
+			loop->nr_body++;
+			work[nr_work++] = x->pred[j];
+		    }
+	    }
+	}
+    }
+
+    // Sort by size, inner loops first. There are few loops, so a simple
+    // insertion sort will do.
+    for(i = 1; i < nr_loops; i++) {
+	natural_loop *loop = loops[i];
+	for(j = i; j > 0 && loops[j - 1]->nr_body > loop->nr_body; j--)
+	    loops[j] = loops[j - 1];
+	loops[j] = loop;
+    }
+
+    delete[] work;
+}
@@ -0,0 +1,181 @@
+#ifndef __FLOWGRAPH_HH__
+#define __FLOWGRAPH_HH__
+
+#include "symtab.hh"
+#include "quads.hh"
+
+
+/* The flow graph is the representation the quad optimizer works on. A quad
+   list is cut into basic blocks, ie, maximal sequences of quads that can
+   only be entered at the top and only be left at the bottom. A new block
+   starts at every q_labl and after every quad that jumps (q_jmp, q_jmpf,
+   q_jmpt, q_ireturn and q_rreturn, and the conditional jumps the optimizer
+   makes last of all, see quads.hh). Note that a q_call does _not_ end a
+   block: the call always returns to the next quad, so for the optimizer a
+   call is just a quad with a lot of side effects.
+
+   The blocks are kept in the same order as the quads were in the list, so
+   a block without a jump at its end falls through to the block after it,
+   just like the code we will later generate for it. */
+
+
+class basic_block;
+class flow_graph;
+class dominator_tree;
+class natural_loop;
+class loop_nest;
+class phi_node;          // See ssa.hh.
+
+
+/* A block can have at most two successors: the block it falls through to,
+   and the block it jumps to. */
+const int MAX_SUCCESSORS = 2;
+
+/* Base size of the dynamic arrays in this file. They are doubled in size
+   whenever they fill up. */
+const int BASE_BLOCK_SIZE = 16;
+
+
+
+/* A basic block. The quads are stored in an array rather than in a linked
+   list since the optimizer passes often need to look at neighbouring quads,
+   and insert or remove quads in the middle of the block. */
+class basic_block {
+public:
+    int          nr;                     // Position in the flow graph.
+
+    quadruple  **quads;                  // The quads in the block, in order.
+    int          nr_quads;               // Nr of quads in the block.
+    int          max_quads;              // Allocated size of quads.
+
+    int          succ[MAX_SUCCESSORS];   // Successor block numbers.
+    int          nr_succ;
+    int         *pred;                   // Predecessor block numbers.
+    int          nr_pred;
+    int          max_pred;
+
+    phi_node    *phis;                   // Phi nodes when in SSA form.
+
+    basic_block(int);                    // Constructor. Arg == nr.
+    ~basic_block();                      // Doesn't delete the quads.
+
+    void         append(quadruple *);    // Add a quad last in the block.
+    void         insert(int, quadruple *); // Insert a quad before position.
+    void         remove(int);            // Remove the quad at position.
+    void         add_pred(int);          // Add a predecessor block.
+
+    int          get_label();            // The label the block starts with,
+                                         // or -1 if it has none.
+    quadruple   *get_last();             // The last quad, or NULL.
+};
+
+
+
+/* The flow graph of one procedure, function or the main program. */
+class flow_graph {
+private:
+    int          max_blocks;             // Allocated size of blocks.
+
+public:
+    basic_block **blocks;                // The blocks, in code order.
+    int          nr_blocks;
+
+    int          last_label;             // The label ending the routine.
+    symbol      *env;                    // The routine the code belongs to.
+
+    // Constructor. Cuts the quad list up into blocks and computes edges.
+    flow_graph(quad_list *, symbol *);
+    ~flow_graph();
+
+    // Recompute the successor and predecessor lists. Must be called after
+    // any pass which adds, removes or reorders blocks or jumps.
+    void         compute_edges();
+
+    // Return the number of the block starting with a given label.
+    int          find_label(int);
+
+    // Create an empty block and place it before the given position.
+    basic_block *insert_block(int);
+
+    // Remove all blocks that can't be reached from the first block. Returns
+    // 1 if something was removed.
+    int          remove_unreachable();
+
+    // Remove jumps to the very next block, which are left behind when the
+    // code between them has been optimized away. Returns 1 if something was
+    // removed.
+    int          remove_useless_jumps();
+
+    // Insert a preheader before the header of a loop, ie, a block which
+    // all edges entering the loop from outside go through instead. Code
+    // placed in it is run once before the loop. The edges are recomputed.
+    basic_block *insert_preheader(natural_loop *);
+
+    // Make sure the first block has no predecessors, by inserting an empty
+    // block first if needed. Passes that need a place to put code which is
+    // run once when the routine starts, like SSA form, depend on this.
+    void         make_entry_block();
+
+    // Put the quads back together into a list again.
+    quad_list   *linearize();
+};
+
+
+
+/* The dominator tree of a flow graph. Block a dominates block b if every
+   path from the first block to b passes through a. The immediate dominator
+   of b is the closest block strictly dominating it. We compute it with the
+   simple iterative algorithm by Cooper, Harvey and Kennedy, which works on
+   the blocks in reverse postorder. Unreachable blocks have no dominator. */
+class dominator_tree {
+private:
+    flow_graph  *cfg;
+
+    void         number_blocks(int, char *);  // Depth first search.
+    int          intersect(int, int);
+
+public:
+    int         *idom;                   // Block nr -> immediate dominator,
+                                         // -1 for the first block.
+    int         *rpo;                    // The blocks in reverse postorder.
+    int          nr_rpo;                 // Nr of reachable blocks.
+    int         *rpo_nr;                 // Block nr -> position in rpo,
+                                         // -1 if unreachable.
+    int        **children;               // The dominator tree itself.
+    int         *nr_children;
+
+    dominator_tree(flow_graph *);
+
+    int          dominates(int, int);    // Does block arg 1 dominate arg 2?
+};
+
+
+
+/* A natural loop. A back edge is an edge from a block to one of its
+   dominators, the header. The loop of a back edge is the header and every
+   block which can reach the back edge without passing the header. Loops with
+   the same header (from continue-like jumps) are merged into one. */
+class natural_loop {
+public:
+    int          header;                 // Block nr of the header.
+    char        *body;                   // Block nr -> 1 if in the loop.
+    int          nr_body;                // Nr of blocks in the loop.
+
+    natural_loop(int, int);              // Constructor. Args == header, nr
+                                         // of blocks in the flow graph.
+};
+
+
+
+/* All the natural loops of a flow graph. They are sorted by size, so an
+   inner loop always comes before the loops it is nested in. */
+class loop_nest {
+public:
+    natural_loop **loops;
+    int          nr_loops;
+
+    loop_nest(flow_graph *, dominator_tree *);
+};
+
+
+#endif
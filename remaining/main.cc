@@ -18,10 +18,15 @@ int no_typecheck = 0;
 int no_optimize = 0;
 int no_quads = 0;
 int no_assembler = 0;
+int print_dataflow = 0;
+int unroll_factor = 4;
+int inline_limit = 16;
+int whole_program = 0;
+int sparc_v8 = 0;
 
 void usage(const char *program_name) {
     cerr << "Usage:\n"
-	 << program_name << " [-acdfpqsty] inputfile\n"
+	 << program_name << " [-acdflmpqstwy] [-i size] [-u factor] inputfile\n"
 	 << program_name << " [-h?]\n"
 	 << "Options:\n"
 	 << "  -h, -?            Shows this message.\n"
@@ -29,17 +34,28 @@ void usage(const char *program_name) {
 	 << "  -c                Disable type checking.\n"
 	 << "  -d                Turn on parser debugging.\n"
 	 << "  -f                Don't optimize.\n"
+	 << "  -i size           Inline routines of at most this many quads\n"
+	 << "                    (default 16, 0 turns inlining off).\n"
+	 << "  -l                Print dataflow sets (liveness etc) for\n"
+	 << "                    the optimized quad lists.\n"
+	 << "  -m                Use the SPARC V8 multiply and divide\n"
+	 << "                    instructions instead of calling\n"
+	 << "                    diesel_glue.s (not for pre-V8 targets).\n"
 	 << "  -p                Don't generate quads.\n"
 	 << "  -q                Print quad lists.\n"
 	 << "  -s                Don't generate assembler code.\n"
 	 << "  -t                Include trace printouts in assembler code.\n"
+	 << "  -u factor         Unroll counted loops this many times\n"
+	 << "                    (default 4, 1 turns unrolling off).\n"
+	 << "  -w                Optimize the whole program at once, using the\n"
+	 << "                    arguments routines are called with.\n"
 	 << "  -y                Print symbol table.\n";    
     exit(1);
 }
     
 
 int main(int argc, char **argv) {
-    const char *options = "acdfpqstyh?";
+    const char *options = "acdfi:lmpqstu:wyh?";
     int option;
     int print_symtab = 0;
     
@@ -67,6 +83,23 @@ int main(int argc, char **argv) {
 		cout << "No optimization will be done.\n" << flush;
 		no_optimize = 1;
 		break;
+	    case 'i':
+		inline_limit = atoi(optarg);
+		if(inline_limit < 0)
+		    usage(argv[0]);
+		cout << "Routines of up to " << inline_limit
+		     << " quads will be inlined.\n" << flush;
+		break;
+	    case 'l':
+		cout << "Dataflow sets will be printed for each block.\n"
+		     << flush;
+		print_dataflow = 1;
+		break;
+	    case 'm':
+		cout << "SPARC V8 multiply and divide instructions will be "
+		     << "used.\n" << flush;
+		sparc_v8 = 1;
+		break;
 	    case 'p':
 		cout << "No quads will be generated.\n" << flush;
 		no_quads = 1;
@@ -84,6 +117,18 @@ int main(int argc, char **argv) {
 		cout << "Assembler code will contain quad labels.\n" << flush;
 		assembler_trace = 1;
 		break;
+	    case 'u':
+		unroll_factor = atoi(optarg);
+		if(unroll_factor < 1)
+		    usage(argv[0]);
+		cout << "Loops will be unrolled " << unroll_factor
+		     << " times.\n" << flush;
+		break;
+	    case 'w':
+		cout << "The whole program will be optimized at once.\n"
+		     << flush;
+		whole_program = 1;
+		break;
 	    case 'y':
 		cout << "Symbol table will be printed after compilation.\n";
 		print_symtab = 1;
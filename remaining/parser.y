@@ -2,6 +2,7 @@
 #include <iostream>
 #include "semantic.hh"
 #include "optimize.hh"
+#include "quadopt.hh"
 #include "codegen.hh"
     
 extern char	      *yytext;           /* Defined in parser.cc */
@@ -22,6 +23,7 @@ extern int             no_typecheck;     /* given to the 'diesel' script. */
 extern int             no_optimize;
 extern int             no_quads;
 extern int             no_assembler;
+extern int             whole_program;
 
 #define YYDEBUG 1
 /* #define YYERROR_VERBOSE */            /* Have this defined to give better
@@ -139,8 +141,38 @@ program		: prog_decl subprog_part comp_stmt T_DOT
 				cout << "\nQuad list for global level" << endl;
 				cout << (quad_list *)q << endl;
 			    }
+
+			    if(!no_optimize) {
+				q = quad_opt->do_optimize(q, env);
+				if(print_quads) {
+				    cout << "\nOptimized quad list for global level"
+					 << endl;
+				    cout << (quad_list *)q << endl;
+				}
+			    }
 			    
-			    if(!no_assembler) {
+			    if(!no_assembler && whole_program && !no_optimize) {
+				// Now that all routines have been seen, they
+				// can be optimized with each other in mind,
+				// and their code generated.
+				quad_opt->defer_routine(q, env);
+				quad_opt->optimize_program();
+				for(int i = 0; i < quad_opt->nr_deferred(); i++) {
+				    symbol *r_env;
+				    q = quad_opt->get_deferred(i, &r_env);
+				    if(print_quads) {
+					cout << "\nWhole program optimized quad "
+					     << "list for \""
+					     << sym_tab->pool_lookup(r_env->id)
+					     << "\"" << endl;
+					cout << (quad_list *)q << endl;
+				    }
+				    cout << "Generating assembler for \""
+					 << sym_tab->pool_lookup(r_env->id)
+					 << "\"" << endl;
+				    code_gen->generate_assembler(q, r_env);
+				}
+			    } else if(!no_assembler) {
 				cout << "Generating assembler, global level"
 				     << endl;
 				code_gen->generate_assembler(q, env);
@@ -356,8 +388,20 @@ subprog_decl	: proc_decl subprog_part comp_stmt T_SEMICOLON
 				     << "\"" << endl;
 				cout << (quad_list *)q << endl;
 			    }
+
+			    if(!no_optimize) {
+				q = quad_opt->do_optimize(q, env);
+				if(print_quads) {
+				    cout << "\nOptimized quad list for \""
+					 << sym_tab->pool_lookup(env->id)
+					 << "\"" << endl;
+				    cout << (quad_list *)q << endl;
+				}
+			    }
 			    
-			    if(!no_assembler) {			
+			    if(!no_assembler && whole_program && !no_optimize)
+				quad_opt->defer_routine(q, env);
+			    else if(!no_assembler) {
 				cout << "Generating assembler for procedure \""
 				     << sym_tab->pool_lookup(env->id)
 				     << "\"" << endl;
@@ -403,8 +447,20 @@ subprog_decl	: proc_decl subprog_part comp_stmt T_SEMICOLON
 				     << "\"" << endl;
 				cout << (quad_list *)q << endl;
 			    }
+
+			    if(!no_optimize) {
+				q = quad_opt->do_optimize(q, env);
+				if(print_quads) {
+				    cout << "\nOptimized quad list for \""
+					 << sym_tab->pool_lookup(env->id)
+					 << "\"" << endl;
+				    cout << (quad_list *)q << endl;
+				}
+			    }
 			    
-			    if(!no_assembler) {			
+			    if(!no_assembler && whole_program && !no_optimize)
+				quad_opt->defer_routine(q, env);
+			    else if(!no_assembler) {
 				cout << "Generating assembler for function \""
 				     << sym_tab->pool_lookup(env->id) << "\""
 				     << endl;
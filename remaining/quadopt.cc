@@ -0,0 +1,3774 @@
+#include <iostream>
+#include "quadopt.hh"
+#include "codegen.hh"
+#include "dataflow.hh"
+
+using namespace std;
+
+
+extern int print_dataflow; // Defined in main.cc.
+extern int unroll_factor;  // Ditto.
+extern int inline_limit;   // Ditto.
+extern int whole_program;  // Ditto.
+extern int sparc_v8;       // Ditto.
+
+
+/* The global quad optimizer object, used in parser.y. */
+quad_optimizer *quad_opt = new quad_optimizer();
+
+
+/* Base size of the value table used in local value numbering. It grows when
+   needed, so this is only a starting point. */
+const int BASE_VALUE_TABLE_SIZE = 64;
+
+/* The largest number of quads loop unrolling may turn the body of a loop
+   into. Larger loops don't gain much from losing a jump, and get in the way
+   of the instruction cache. */
+const int MAX_UNROLLED_QUADS = 64;
+
+/* The largest routine (in quads) we make specialized copies of, and the
+   largest number of copies made of each. */
+const int MAX_CLONED_QUADS = 128;
+const int MAX_CLONES = 2;
+
+/* The lattice values of sparse conditional constant propagation. A symbol
+   starts out as TOP, meaning we haven't seen it assigned yet, and can only
+   move downwards: to CONST when it has been assigned a constant, and to
+   BOTTOM when it might hold different values. */
+const char LATTICE_TOP = 0;
+const char LATTICE_CONST = 1;
+const char LATTICE_BOTTOM = 2;
+
+
+
+/* An entry in the value table of local value numbering. Each entry describes
+   a computation by its operator and the value numbers of its arguments (or
+   the constant it loads, or the array it indexes), and records which value
+   number the result got and which symbol it was first stored in. */
+class value_entry {
+public:
+    quad_op_type op;
+    long         arg1;       // Value number, constant or array symbol.
+    long         arg2;       // Value number, or 0 if unused.
+    int          memory;     // For array loads: version of the array.
+    int          value;      // The value number of the result.
+    sym_index    holder;     // The symbol the result was first stored in.
+};
+
+
+
+/* A read of a symbol in SSA form, either by a quad or by a phi node. The
+   reads of each symbol are linked together through next. */
+class ssa_use {
+public:
+    basic_block *b;
+    quadruple   *q;          // The quad reading the symbol, or NULL.
+    phi_node    *phi;        // The phi node reading it, or NULL.
+    int          next;       // Index of the next read, -1 if none.
+};
+
+
+
+/* The saved body of a routine which may be inlined. */
+class inline_body {
+public:
+    sym_index    routine;
+    quadruple  **quads;      // Its optimized quads.
+    int          nr_quads;
+    sym_index   *params;     // Its parameters, first parameter first.
+    int          nr_params;
+    bit_set     *uninitialized; // Its variables which may be read before
+                                // they are assigned.
+};
+
+
+
+/* A routine whose code generation has been put off until the whole program
+   has been seen (the -w flag). */
+class program_routine {
+public:
+    symbol      *env;
+    sym_index    env_p;
+    bit_set     *own_syms;   // Its symbols (see defer_routine()). A clone
+                             // has a copy of those of the original.
+    quad_list   *quads;      // Its optimized quads.
+    sym_index   *params;     // Its parameters, first parameter first.
+    int          nr_params;
+    int          nr_clones;  // Nr of specialized copies made of it.
+    int          changed;    // 1 if it must be optimized again.
+};
+
+
+
+/* A basic induction variable of the loop being strength reduced. */
+class induction_variable {
+public:
+    sym_index    sym;
+    quadruple   *step_quad;  // The quad stepping it.
+    basic_block *block;      // The block step_quad is in.
+    sym_index    step;       // The invariant it is stepped by.
+    sym_index    step4;      // 4 * step, or NULL_SYM if not computed yet.
+    quadruple   *test;       // The test ending the loop.
+    sym_index    bound;      // The constant it compares with.
+    int          removable;  // 1 if it can be removed. See is_removable().
+};
+
+
+
+/* A pointer created by strength reduction. It always holds the address of
+   array[iv op offset], where iv is an induction variable. */
+class derived_pointer {
+public:
+    sym_index    array;
+    int          iv;         // Index in the induction variable table.
+    quad_op_type op;         // q_iplus or q_iminus.
+    sym_index    offset;     // The invariant offset, or NULL_SYM if none.
+    sym_index    pointer;    // The temporary holding the address.
+    int          in_step_block; // 1 if the array is accessed through it in
+                                // the block stepping iv, before the step.
+};
+
+
+
+/* The constructor. The per-symbol tables are indexed by sym_index, and
+   since the symbol table has a fixed maximum size, so have they. */
+quad_optimizer::quad_optimizer() {
+    def_count = new int[MAX_SYM];
+    use_count = new int[MAX_SYM];
+    use_block = new int[MAX_SYM];
+
+    value_nr = new int[MAX_SYM];
+    renamed = new sym_index[MAX_SYM];
+    array_version = new int[MAX_SYM];
+    is_touched = new char[MAX_SYM];
+    touched = new sym_index[MAX_SYM];
+    nr_touched = 0;
+    for(int i = 0; i < MAX_SYM; i++) {
+	value_nr[i] = 0;
+	renamed[i] = NULL_SYM;
+	array_version[i] = 0;
+	is_touched[i] = 0;
+    }
+
+    max_values = BASE_VALUE_TABLE_SIZE;
+    values = new value_entry[max_values];
+    nr_values = 0;
+
+    forwarded = new sym_index[MAX_SYM];
+    max_constants = BASE_VALUE_TABLE_SIZE;
+    constants = new sym_index[max_constants];
+    nr_constants = 0;
+
+    lattice = new char[MAX_SYM];
+    lattice_value = new int[MAX_SYM];
+    first_use = new int[MAX_SYM];
+    max_ssa_uses = BASE_VALUE_TABLE_SIZE;
+    ssa_uses = new ssa_use[max_ssa_uses];
+    nr_ssa_uses = 0;
+    sym_work = new sym_index[MAX_SYM];
+    in_sym_work = new char[MAX_SYM];
+    nr_sym_work = 0;
+
+    max_inline = BASE_VALUE_TABLE_SIZE;
+    inline_bodies = new inline_body[max_inline];
+    nr_inline = 0;
+
+    max_routines = BASE_VALUE_TABLE_SIZE;
+    routines = new program_routine[max_routines];
+    nr_routines = 0;
+
+    outer_refs = new bit_set(MAX_SYM);
+
+    cfg = NULL;
+    loop_blocks = NULL;
+    preheader = NULL;
+    assigned = NULL;
+    callees = NULL;
+    ivs = NULL;
+    pointers = NULL;
+}
+
+
+
+/* Return the symbol table index of a routine. Looking up its name would
+   find a variable of the same name instead, if the routine declares
+   one. */
+static sym_index routine_index(symbol *env) {
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++)
+	if(sym_tab->get_symbol(sym_p) == env)
+	    return sym_p;
+    fatal("routine_index(): routine not in the symbol table");
+    return NULL_SYM;
+}
+
+
+/* Return the index the next symbol entered in the symbol table will get. */
+static sym_index next_symbol_index() {
+    sym_index sym_p = 0;
+
+    while(sym_p < MAX_SYM && sym_tab->get_symbol(sym_p) != NULL)
+	sym_p++;
+    return sym_p;
+}
+
+
+/* Add the symbols entered in the symbol table from sym_p on to a set. */
+static void add_symbols_from(bit_set *syms, sym_index sym_p) {
+    for(; sym_p < MAX_SYM && sym_tab->get_symbol(sym_p) != NULL; sym_p++)
+	syms->add(sym_p);
+}
+
+
+/* This is the interface to parser.y. We build a flow graph for the quads,
+   run the passes over it and put the quads back into a list again. */
+quad_list *quad_optimizer::do_optimize(quad_list *q_list, symbol *env) {
+    q_list = eliminate_tail_recursion(q_list, env);
+    if(inline_limit > 0)
+	q_list = inline_calls(q_list);
+    cfg = new flow_graph(q_list, env);
+
+    optimize_scalars();
+    loop_optimization();
+    dead_store_elimination();
+
+    if(print_dataflow)
+	print_dataflow_sets();
+
+    quad_list *result = cfg->linearize();
+    if(inline_limit > 0)
+	save_for_inlining(result, env);
+    delete cfg;
+    cfg = NULL;
+    note_outer_references(result, env);
+    if(!whole_program)
+	result = fuse_conditional_jumps(result);
+    // The symbols of the routine are the last ones entered so far.
+    bit_set *own_syms = new bit_set(MAX_SYM);
+    add_symbols_from(own_syms, routine_index(env) + 1);
+    allocate_storage(result, env, own_syms);
+    delete own_syms;
+    return result;
+}
+
+
+
+/* Run the passes which don't work on loops over the current flow graph. */
+void quad_optimizer::optimize_scalars() {
+    count_symbols();
+    for(int i = 0; i < cfg->nr_blocks; i++)
+	local_value_numbering(cfg->blocks[i]);
+
+    copy_propagation();
+    dead_code_elimination();
+
+    ssa = new ssa_form(cfg);
+    constant_propagation();
+    ssa->dead_code_elimination();
+    if(print_dataflow)
+	print_ssa_form();
+    ssa->destruct();
+    delete ssa;
+    ssa = NULL;
+
+    // The SSA pass drops the results of calls nobody uses, which can leave
+    // calls to pure functions with nothing to do.
+    count_symbols();
+    dead_code_elimination();
+}
+
+
+
+/* Print the result of the dataflow analyses for the optimized routine. This
+   is mostly useful when debugging the passes using them. */
+void quad_optimizer::print_dataflow_sets() {
+    char *name = sym_tab->pool_lookup(cfg->env->id);
+
+    cout << "\nDataflow sets for \"" << name << "\"" << endl;
+    cout << "Quads per block:" << endl << short_symbols;
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	cout << "  Block " << i << endl;
+	for(int j = 0; j < cfg->blocks[i]->nr_quads; j++)
+	    cout << cfg->blocks[i]->quads[j] << endl;
+    }
+    cout << long_symbols << endl;
+
+    liveness *live = new liveness(cfg);
+    live->print(cout, "Live variables:");
+    reaching_definitions *reach = new reaching_definitions(cfg);
+    reach->print(cout, "Reaching definitions:");
+    available_expressions *avail = new available_expressions(cfg);
+    avail->print(cout, "Available expressions:");
+
+    delete live;
+    delete reach;
+    delete avail;
+    delete[] name;
+}
+
+
+
+/* Print the routine in SSA form, phi nodes first in each block. */
+void quad_optimizer::print_ssa_form() {
+    char *name = sym_tab->pool_lookup(cfg->env->id);
+
+    cout << "\nSSA form for \"" << name << "\"" << endl;
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	cout << "  Block " << i << " (idom " << ssa->dom->idom[i] << ")"
+	     << endl;
+	ssa->print_phis(cout, b);
+	cout << short_symbols;
+	for(int j = 0; j < b->nr_quads; j++)
+	    cout << b->quads[j] << endl;
+	cout << long_symbols;
+    }
+    cout << endl;
+
+    delete[] name;
+}
+
+
+
+/* Count how many times each symbol is assigned and read in the current
+   routine, and in which blocks it is read. */
+void quad_optimizer::count_symbols() {
+    sym_index uses[MAX_QUAD_USES];
+    int i;
+
+    for(i = 0; i < MAX_SYM; i++) {
+	def_count[i] = 0;
+	use_count[i] = 0;
+	use_block[i] = -1;
+    }
+
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(int j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    sym_index def = q->get_def();
+	    if(def != NULL_SYM)
+		def_count[def]++;
+
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++) {
+		if(uses[u] == NULL_SYM)
+		    continue;
+		use_count[uses[u]]++;
+		if(use_block[uses[u]] == -1)
+		    use_block[uses[u]] = i;
+		else if(use_block[uses[u]] != i)
+		    use_block[uses[u]] = -2;
+	    }
+	}
+    }
+}
+
+
+
+/* A symbol is stable if it holds the same value everywhere it can be read.
+   Constants are, and so are temporaries that are assigned only once: quads.cc
+   never reads a temporary before it has been assigned. */
+int quad_optimizer::is_stable(sym_index sym_p) {
+    if(sym_tab->get_symbol_tag(sym_p) == SYM_CONST)
+	return 1;
+    return sym_tab->is_temp_var(sym_p) && def_count[sym_p] == 1;
+}
+
+
+
+/****************
+ *** INLINING ***
+ ****************/
+
+
+/* Returns 1 if the sym1 field of a quad holds a symbol. The quads made with
+   an int as their first argument leave it unset. */
+static int has_sym1(quad_op_type op) {
+    switch(op) {
+    case q_rload:
+    case q_iload:
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmp:
+    case q_jmpf:
+    case q_jmpt:
+    case q_labl:
+    case q_nop:
+	return 0;
+    default:
+	return 1;
+    }
+}
+
+
+/* Return the parameters of a procedure or function, first parameter first,
+   and store how many they are in nr_params. They can only be looked up
+   while we're still in the routine's scope. */
+static sym_index *find_formals(symbol *env, int *nr_params) {
+    parameter_symbol *param;
+    if(env->tag == SYM_PROC)
+	param = env->get_procedure_symbol()->last_parameter;
+    else
+	param = env->get_function_symbol()->last_parameter;
+
+    *nr_params = 0;
+    for(parameter_symbol *p = param; p != NULL; p = p->preceding)
+	(*nr_params)++;
+    sym_index *params = new sym_index[*nr_params + 1];
+    for(int i = *nr_params - 1; i >= 0; i--) {
+	params[i] = sym_tab->lookup_symbol(param->id);
+	param = param->preceding;
+    }
+    return params;
+}
+
+
+/* Returns 1 if a quad ends a basic block or starts one. */
+static int is_block_boundary(quad_op_type op) {
+    return op == q_labl || op == q_jmp || op == q_jmpf || op == q_jmpt ||
+	op == q_rreturn || op == q_ireturn;
+}
+
+
+/* Save the optimized quads of a procedure or function, if it can be
+   inlined. It can if it is small enough (the -i flag), doesn't call itself,
+   and doesn't need a frame of its own: it mustn't have local arrays, or
+   call routines nested inside it, since they reach its variables through
+   the display. Its variables and parameters can be replaced by variables
+   of the caller, since the display reaches everything else no matter which
+   routine the code is in.
+
+   We don't inline routines with loops either. They spend their time in
+   the loop rather than in the call, so there is little to gain, and their
+   variables may end up far out in a large frame, where they are more
+   expensive to reach. */
+void quad_optimizer::save_for_inlining(quad_list *q_list, symbol *env) {
+    if(env->tag != SYM_PROC && env->tag != SYM_FUNC)
+	return;
+
+    sym_index env_p = routine_index(env);
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quadruple *q;
+    int nr_quads = 0;
+    int size = 0;
+    int i;
+
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next()) {
+	nr_quads++;
+	if(q->op_code != q_labl)
+	    size++;
+    }
+    delete ql_iterator;
+    if(size > inline_limit)
+	return;
+
+    quadruple **quads = new quadruple *[nr_quads];
+    nr_quads = 0;
+    ql_iterator = new quad_list_iterator(q_list);
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	quads[nr_quads++] = q;
+    delete ql_iterator;
+
+    for(i = 0; i < nr_quads; i++) {
+	q = quads[i];
+	int is_loop = 0;
+	if(q->op_code == q_jmp || q->op_code == q_jmpf ||
+	   q->op_code == q_jmpt)
+	    for(int j = 0; j < i; j++)
+		if(quads[j]->op_code == q_labl && quads[j]->int1 == q->int1)
+		    is_loop = 1;
+	if(is_loop ||
+	   (q->op_code == q_call &&
+	    (q->sym1 == env_p ||
+	     sym_tab->get_symbol(q->sym1)->level > env->level)) ||
+	   ((q->op_code == q_lindex || q->op_code == q_irindex ||
+	     q->op_code == q_rrindex) &&
+	    sym_tab->get_symbol(q->sym1)->level > env->level)) {
+	    delete[] quads;
+	    return;
+	}
+    }
+
+    if(nr_inline == max_inline) {
+	inline_body *new_bodies = new inline_body[max_inline * 2];
+	for(i = 0; i < nr_inline; i++)
+	    new_bodies[i] = inline_bodies[i];
+	delete[] inline_bodies;
+	inline_bodies = new_bodies;
+	max_inline *= 2;
+    }
+
+    inline_body *body = &inline_bodies[nr_inline++];
+    body->routine = env_p;
+
+    body->params = find_formals(env, &body->nr_params);
+
+    body->quads = new quadruple *[nr_quads];
+    body->nr_quads = nr_quads;
+    for(i = 0; i < nr_quads; i++)
+	body->quads[i] = new quadruple(*quads[i]);
+    delete[] quads;
+
+    // The variables which may be read before they are assigned (ie, are
+    // live when the routine starts) must be replaced by variables. All
+    // others can be replaced by temporaries, which the optimizer knows no
+    // other routine can see.
+    liveness *live = new liveness(cfg);
+    body->uninitialized = new bit_set(MAX_SYM);
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++)
+	if(live->in[0]->member(sym_p) &&
+	   sym_tab->get_symbol_tag(sym_p) == SYM_VAR)
+	    body->uninitialized->add(sym_p);
+    delete live;
+}
+
+
+/* Return the saved body of a routine, or NULL if it can't be inlined. */
+inline_body *quad_optimizer::find_inline_body(sym_index routine) {
+    for(int i = 0; i < nr_inline; i++)
+	if(inline_bodies[i].routine == routine)
+	    return &inline_bodies[i];
+    return NULL;
+}
+
+
+/* Find the q_param quads belonging to the call at position pos, and store
+   their positions in params, first argument first. Arguments are computed
+   (and their q_params placed) last argument first, and may contain calls of
+   their own, whose q_params we skip. Returns 1 if all of them were found in
+   the same basic block as the call. */
+static int find_params(quadruple **quads, int pos, int *params) {
+    int nr_params = quads[pos]->int2;
+    int nr_found = 0;
+    int skip = 0;
+
+    for(int i = pos - 1; i >= 0 && nr_found < nr_params; i--) {
+	if(is_block_boundary(quads[i]->op_code))
+	    return 0;
+	if(quads[i]->op_code == q_call)
+	    skip += quads[i]->int2;
+	else if(quads[i]->op_code == q_param) {
+	    if(skip > 0)
+		skip--;
+	    else
+		params[nr_found++] = i;
+	}
+    }
+    return nr_found == nr_params;
+}
+
+
+/* Check if the call at pos is to a routine without side effects, whose
+   parameters are passed right before it. In that case params is filled
+   in as by find_params(), and the call can be removed, or numbered like
+   any other computation, since nothing can change the arguments between
+   the parameters and the call. */
+static int is_pure_call(quadruple **quads, int pos, int *params) {
+    effect_summary *effects = sym_tab->get_effects(quads[pos]->sym1);
+
+    if(effects == NULL || !effects->is_pure() ||
+       !find_params(quads, pos, params))
+	return 0;
+    for(int i = pos - quads[pos]->int2; i < pos; i++)
+	if(quads[i]->op_code != q_param)
+	    return 0;
+    return 1;
+}
+
+
+/* Append the body of a routine to a quad list, in place of a call to it.
+   The arguments are copied into the variables standing in for the
+   parameters, the variables, parameters and temporaries of the routine are
+   replaced by new ones in the current routine, and the labels by new
+   labels. A return becomes a copy to the symbol the call assigns, and a
+   jump to the end of the body. */
+void quad_optimizer::expand_call(quad_list *q_list, quadruple *call,
+				 sym_index *args, inline_body *body) {
+    symbol *routine = sym_tab->get_symbol(body->routine);
+    int max_syms = 3 * body->nr_quads + body->nr_params + 1;
+    sym_index *old_syms = new sym_index[max_syms];
+    sym_index *new_syms = new sym_index[max_syms];
+    int *old_labels = new int[body->nr_quads + 1];
+    int *new_labels = new int[body->nr_quads + 1];
+    int nr_syms = 0;
+    int nr_labels = 0;
+    int i, j;
+
+    for(i = 0; i < body->nr_params; i++) {
+	old_syms[i] = body->params[i];
+	new_syms[i] = sym_tab->gen_temp_var(sym_tab->
+					    get_symbol_type(old_syms[i]));
+    }
+    nr_syms = body->nr_params;
+
+    for(i = 0; i < body->nr_params; i++)
+	*q_list += new quadruple((sym_tab->get_symbol_type(new_syms[i]) ==
+				  real_type ? q_rassign : q_iassign),
+				 args[i], NULL_SYM, new_syms[i]);
+
+    for(i = 0; i < body->nr_quads; i++) {
+	quadruple *q = new quadruple(*body->quads[i]);
+	sym_index *fields[3] = { &q->sym1, &q->sym2, &q->sym3 };
+
+	for(int f = 0; f < 3; f++) {
+	    sym_index sym_p = *fields[f];
+	    if((f == 0 && !has_sym1(q->op_code)) ||
+	       (f == 1 && q->op_code == q_call) || sym_p == NULL_SYM)
+		continue;
+	    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+	    if((tag != SYM_VAR && tag != SYM_PARAM) ||
+	       sym_tab->get_symbol(sym_p)->level <= routine->level)
+		continue;
+
+	    for(j = 0; j < nr_syms; j++)
+		if(old_syms[j] == sym_p)
+		    break;
+	    if(j == nr_syms) {
+		old_syms[j] = sym_p;
+		new_syms[j] = (body->uninitialized->member(sym_p) ?
+			       sym_tab->gen_copy_var(sym_p) :
+			       sym_tab->gen_temp_var(sym_tab->
+						     get_symbol_type(sym_p)));
+		nr_syms++;
+	    }
+	    *fields[f] = new_syms[j];
+	}
+
+	switch(q->op_code) {
+	case q_labl:
+	case q_jmp:
+	case q_jmpf:
+	case q_jmpt:
+	case q_rreturn:
+	case q_ireturn:
+	    for(j = 0; j < nr_labels; j++)
+		if(old_labels[j] == q->int1)
+		    break;
+	    if(j == nr_labels) {
+		old_labels[j] = q->int1;
+		new_labels[j] = sym_tab->get_next_label();
+		nr_labels++;
+	    }
+	    q->int1 = new_labels[j];
+	    break;
+	default:
+	    break;
+	}
+
+	if(q->op_code == q_rreturn || q->op_code == q_ireturn) {
+	    if(call->sym3 != NULL_SYM)
+		*q_list += new quadruple((q->op_code == q_rreturn ? q_rassign :
+					  q_iassign), q->sym2, NULL_SYM,
+					 call->sym3);
+	    *q_list += new quadruple(q_jmp, q->int1, NULL_SYM, NULL_SYM);
+	} else
+	    *q_list += q;
+    }
+
+    delete[] old_syms;
+    delete[] new_syms;
+    delete[] old_labels;
+    delete[] new_labels;
+}
+
+
+/* Inline the calls to small routines (see save_for_inlining) in a quad
+   list. This is done before anything else, so that the body is optimized
+   together with the code around the call, with the arguments it was
+   actually given. Returns the new quad list. */
+quad_list *quad_optimizer::inline_calls(quad_list *q_list) {
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quadruple *q;
+    int nr_quads = 0;
+    int i, j;
+
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	nr_quads++;
+    delete ql_iterator;
+
+    quadruple **quads = new quadruple *[nr_quads + 1];
+    char *removed = new char[nr_quads + 1];
+    int *params = new int[nr_quads + 1];
+    inline_body **bodies = new inline_body *[nr_quads + 1];
+    int found = 0;
+
+    nr_quads = 0;
+    ql_iterator = new quad_list_iterator(q_list);
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	quads[nr_quads++] = q;
+    delete ql_iterator;
+
+    // Find the calls to inline and the q_params they use.
+    for(i = 0; i < nr_quads; i++) {
+	removed[i] = 0;
+	bodies[i] = NULL;
+	if(quads[i]->op_code != q_call ||
+	   (bodies[i] = find_inline_body(quads[i]->sym1)) == NULL)
+	    continue;
+	if(quads[i]->int2 != bodies[i]->nr_params ||
+	   !find_params(quads, i, params)) {
+	    bodies[i] = NULL;
+	    continue;
+	}
+	for(j = 0; j < quads[i]->int2; j++)
+	    removed[params[j]] = 1;
+	found = 1;
+    }
+
+    if(!found) {
+	delete[] quads;
+	delete[] removed;
+	delete[] params;
+	delete[] bodies;
+	return q_list;
+    }
+
+    quad_list *result = new quad_list(q_list->last_label);
+    sym_index *args = new sym_index[nr_quads + 1];
+    for(i = 0; i < nr_quads; i++) {
+	if(removed[i])
+	    continue;
+	if(bodies[i] == NULL) {
+	    *result += quads[i];
+	    continue;
+	}
+	find_params(quads, i, params);
+	for(j = 0; j < quads[i]->int2; j++)
+	    args[j] = quads[params[j]]->sym1;
+	expand_call(result, quads[i], args, bodies[i]);
+    }
+
+    delete[] quads;
+    delete[] removed;
+    delete[] params;
+    delete[] bodies;
+    delete[] args;
+    return result;
+}
+
+
+
+/**********************
+ *** TAIL RECURSION ***
+ **********************/
+
+
+/* Turn calls a routine makes to itself, just before it returns, into a jump
+   back to its start. There is nothing left to do in the current activation
+   after such a call, so instead of making a new one we can reuse it: the
+   arguments are assigned to the parameters, and we start over. The
+   recursion becomes a loop, which the loop passes can work on, and a deep
+   recursion no longer needs a register window and frame per call.
+
+   A call is in tail position if the routine returns right after it: for a
+   function, the result is returned as it is, and for a procedure, the next
+   thing done (labels and jumps further down aside) is to jump to the end
+   of the routine or to fall off it. The arguments are first copied into
+   temporaries, since they may read the parameters we're about to assign.
+   Returns the new quad list. */
+quad_list *quad_optimizer::eliminate_tail_recursion(quad_list *q_list,
+						    symbol *env) {
+    if(env->tag != SYM_PROC && env->tag != SYM_FUNC)
+	return q_list;
+
+    sym_index env_p = routine_index(env);
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quadruple *q;
+    int nr_quads = 0;
+    int i, j;
+
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	nr_quads++;
+    delete ql_iterator;
+
+    quadruple **quads = new quadruple *[nr_quads + 1];
+    char *removed = new char[nr_quads + 1];
+    char *is_tail_call = new char[nr_quads + 1];
+    int *params = new int[nr_quads + 1];
+    int found = 0;
+
+    nr_quads = 0;
+    ql_iterator = new quad_list_iterator(q_list);
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	quads[nr_quads++] = q;
+    delete ql_iterator;
+
+    for(i = 0; i < nr_quads; i++) {
+	removed[i] = 0;
+	is_tail_call[i] = 0;
+    }
+    for(i = 0; i < nr_quads; i++) {
+	q = quads[i];
+	if(q->op_code != q_call || q->sym1 != env_p)
+	    continue;
+	// Skip labels, and follow jumps further down.
+	int target = -1;
+	for(j = i + 1; j < nr_quads; j++) {
+	    if(quads[j]->op_code == q_labl) {
+		if(quads[j]->int1 == target)
+		    target = -1;
+	    } else if(target < 0) {
+		if(quads[j]->op_code != q_jmp ||
+		   quads[j]->int1 == q_list->last_label)
+		    break;
+		target = quads[j]->int1;
+	    }
+	}
+	if(target >= 0)
+	    continue;
+	if(q->sym3 != NULL_SYM) {
+	    if(j == nr_quads ||
+	       (quads[j]->op_code != q_ireturn &&
+		quads[j]->op_code != q_rreturn) ||
+	       quads[j]->sym2 != q->sym3)
+		continue;
+	} else if(j < nr_quads &&
+		  (quads[j]->op_code != q_jmp ||
+		   quads[j]->int1 != q_list->last_label))
+	    continue;
+	if(!find_params(quads, i, params))
+	    continue;
+	for(j = 0; j < q->int2; j++)
+	    removed[params[j]] = 1;
+	is_tail_call[i] = 1;
+	found = 1;
+    }
+
+    if(!found) {
+	delete[] quads;
+	delete[] removed;
+	delete[] is_tail_call;
+	delete[] params;
+	return q_list;
+    }
+
+    int nr_formals;
+    sym_index *formals = find_formals(env, &nr_formals);
+    sym_index *temps = new sym_index[nr_formals + 1];
+    int start = sym_tab->get_next_label();
+    quad_list *result = new quad_list(q_list->last_label);
+
+    *result += new quadruple(q_labl, start, NULL_SYM, NULL_SYM);
+    for(i = 0; i < nr_quads; i++) {
+	if(removed[i])
+	    continue;
+	if(!is_tail_call[i]) {
+	    *result += quads[i];
+	    continue;
+	}
+	find_params(quads, i, params);
+	for(j = 0; j < nr_formals; j++) {
+	    sym_index type = sym_tab->get_symbol_type(formals[j]);
+	    temps[j] = sym_tab->gen_temp_var(type);
+	    *result += new quadruple((type == real_type ? q_rassign :
+				      q_iassign), quads[params[j]]->sym1,
+				     NULL_SYM, temps[j]);
+	}
+	for(j = 0; j < nr_formals; j++)
+	    *result += new quadruple((sym_tab->get_symbol_type(formals[j]) ==
+				      real_type ? q_rassign : q_iassign),
+				     temps[j], NULL_SYM, formals[j]);
+	*result += new quadruple(q_jmp, start, NULL_SYM, NULL_SYM);
+    }
+
+    delete[] quads;
+    delete[] removed;
+    delete[] is_tail_call;
+    delete[] params;
+    delete[] formals;
+    delete[] temps;
+    return result;
+}
+
+
+
+/****************************
+ *** LOCAL VALUE NUMBERING ***
+ ****************************/
+
+
+/* Returns 1 if the order of the arguments doesn't matter for an operator. */
+static int is_commutative(quad_op_type op) {
+    switch(op) {
+    case q_rplus:
+    case q_iplus:
+    case q_rmult:
+    case q_imult:
+    case q_ior:
+    case q_iand:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+
+/* Remember that a symbol's entries in the per-symbol tables are in use, so
+   they can be cleared when the next block is started. */
+void quad_optimizer::touch(sym_index sym_p) {
+    if(!is_touched[sym_p]) {
+	is_touched[sym_p] = 1;
+	touched[nr_touched++] = sym_p;
+    }
+}
+
+
+/* Look up a computation in the value table. Returns its position, or -1 if
+   it isn't there. */
+int quad_optimizer::find_value(quad_op_type op, long arg1, long arg2,
+			       int memory) {
+    for(int i = 0; i < nr_values; i++)
+	if(values[i].op == op && values[i].arg1 == arg1 &&
+	   values[i].arg2 == arg2 && values[i].memory == memory)
+	    return i;
+    return -1;
+}
+
+
+/* Enter a new computation in the value table. If value is 0 the result gets
+   a new value number, otherwise it is known to equal that value. Returns the
+   value number. */
+int quad_optimizer::add_value(quad_op_type op, long arg1, long arg2,
+			      int memory, sym_index holder, int value) {
+    if(nr_values == max_values) {
+	value_entry *new_values = new value_entry[max_values * 2];
+	for(int i = 0; i < nr_values; i++)
+	    new_values[i] = values[i];
+	delete[] values;
+	values = new_values;
+	max_values *= 2;
+    }
+
+    values[nr_values].op = op;
+    values[nr_values].arg1 = arg1;
+    values[nr_values].arg2 = arg2;
+    values[nr_values].memory = memory;
+    values[nr_values].value = (value != 0 ? value : ++last_value_nr);
+    values[nr_values].holder = holder;
+    nr_values++;
+
+    return values[nr_values - 1].value;
+}
+
+
+/* Return the position in the value table of the computation that gave a
+   value number, or -1 if it isn't found. */
+int quad_optimizer::find_entry(int value) {
+    for(int i = 0; i < nr_values; i++)
+	if(values[i].value == value)
+	    return i;
+    return -1;
+}
+
+
+/* Return the value number of a symbol. A variable which hasn't been seen
+   yet in this block gets a new value number, representing "whatever it
+   contained when we entered the block". A constant gets the same value
+   number as a q_iload/q_rload of the same value, so both can be shared. */
+int quad_optimizer::value_of(sym_index sym_p) {
+    if(value_nr[sym_p] != 0)
+	return value_nr[sym_p];
+
+    touch(sym_p);
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if(sym->tag == SYM_CONST) {
+	constant_symbol *con = sym->get_constant_symbol();
+	quad_op_type op = (con->type == real_type ? q_rload : q_iload);
+	int pos = find_value(op, con->const_value.ival, 0, 0);
+	if(pos >= 0)
+	    value_nr[sym_p] = values[pos].value;
+	else
+	    value_nr[sym_p] = add_value(op, con->const_value.ival, 0, 0,
+					sym_p, 0);
+    } else
+	value_nr[sym_p] = ++last_value_nr;
+
+    return value_nr[sym_p];
+}
+
+
+/* Local value numbering on one basic block. Each quad computing something
+   from its operands gets a key made from the operator and the value numbers
+   of the operands. If the key has been seen before, and the symbol holding
+   that earlier result still holds it, the quad is redundant.
+
+   A redundant quad whose result is a temporary read only in this block is
+   removed, and all later reads of the temporary are redirected to the
+   earlier one. Otherwise it is replaced with a cheaper copy of the earlier
+   result.
+
+   Calls may change the variables and arrays the callee's effect summary
+   says it writes (see symtab.hh), or if we don't know, any variable visible
+   to the callee and any array, so after a q_call we forget what we know
+   about those. Calls to pure functions change nothing, and are numbered
+   like other computations, with the arguments as operands. A store
+   changes the array its address was computed from with q_lindex, or, if
+   we don't know which array that is, all arrays. In the first case we
+   also know what a load from the same element would give, so such a load
+   can be replaced with the value stored. */
+int quad_optimizer::local_value_numbering(basic_block *b) {
+    sym_index uses[MAX_QUAD_USES];
+    int params[2];
+    effect_summary *effects;
+    int changed = 0;
+    int i;
+
+    // Start with empty tables.
+    for(i = 0; i < nr_touched; i++) {
+	value_nr[touched[i]] = 0;
+	renamed[touched[i]] = NULL_SYM;
+	array_version[touched[i]] = 0;
+	is_touched[touched[i]] = 0;
+    }
+    nr_touched = 0;
+    nr_values = 0;
+    last_value_nr = 0;
+    int last_memory = 0;      // Memory version counter.
+    int clobbered = 0;        // Memory version of the last call.
+
+    for(i = 0; i < b->nr_quads; i++) {
+	quadruple *q = b->quads[i];
+
+	// First redirect reads of temporaries we have removed.
+	int nr_uses = q->get_uses(uses);
+	for(int u = 0; u < nr_uses; u++)
+	    if(uses[u] != NULL_SYM && renamed[uses[u]] != NULL_SYM) {
+		q->replace_use(uses[u], renamed[uses[u]]);
+		changed = 1;
+	    }
+
+	quad_op_type op = q->op_code;
+	sym_index dest = q->sym3;
+	long arg1 = 0, arg2 = 0;
+	int memory = 0;
+	int pos;
+
+	switch(op) {
+	case q_rload:
+	case q_iload:
+	    arg1 = q->int1;
+	    break;
+
+	case q_inot:
+	case q_ruminus:
+	case q_iuminus:
+	case q_itor:
+	    arg1 = value_of(q->sym1);
+	    break;
+
+	case q_rplus:
+	case q_iplus:
+	case q_rminus:
+	case q_iminus:
+	case q_ior:
+	case q_iand:
+	case q_rmult:
+	case q_imult:
+	case q_rdivide:
+	case q_idivide:
+	case q_imod:
+	case q_req:
+	case q_ieq:
+	case q_rne:
+	case q_ine:
+	case q_rlt:
+	case q_ilt:
+	    arg1 = value_of(q->sym1);
+	    arg2 = value_of(q->sym2);
+	    if(is_commutative(op) && arg1 > arg2) {
+		long tmp = arg1;
+		arg1 = arg2;
+		arg2 = tmp;
+	    }
+	    break;
+
+	case q_rgt:
+	case q_igt:
+	    // a > b is the same thing as b < a.
+	    op = (op == q_rgt ? q_rlt : q_ilt);
+	    arg1 = value_of(q->sym2);
+	    arg2 = value_of(q->sym1);
+	    break;
+
+	case q_lindex:
+	    arg1 = q->sym1;
+	    arg2 = value_of(q->sym2);
+	    break;
+
+	case q_rrindex:
+	case q_irindex:
+	    arg1 = q->sym1;
+	    arg2 = value_of(q->sym2);
+	    memory = array_version[q->sym1];
+	    if(clobbered > memory)
+		memory = clobbered;
+	    break;
+
+	case q_rassign:
+	case q_iassign:
+	    touch(dest);
+	    // Assigning a variable the value it already holds does nothing.
+	    if(value_nr[dest] == value_of(q->sym1)) {
+		b->remove(i--);
+		changed = 1;
+	    } else
+		value_nr[dest] = value_of(q->sym1);
+	    continue;
+
+	case q_rstore:
+	case q_istore:
+	    pos = find_entry(value_of(q->sym3));
+	    if(pos >= 0 && values[pos].op == q_lindex) {
+		sym_index array = values[pos].arg1;
+		touch(array);
+		array_version[array] = ++last_memory;
+		if(clobbered > array_version[array])
+		    array_version[array] = clobbered;
+		add_value((op == q_istore ? q_irindex : q_rrindex),
+			  array, values[pos].arg2, array_version[array],
+			  q->sym1, value_of(q->sym1));
+	    } else
+		clobbered = ++last_memory;
+	    continue;
+
+	case q_rfetch:
+	case q_ifetch:
+	    // We don't know which array the address points into, so the
+	    // result is a value we haven't seen before.
+	    touch(dest);
+	    value_nr[dest] = ++last_value_nr;
+	    continue;
+
+	case q_call:
+	    effects = sym_tab->get_effects(q->sym1);
+	    if(dest != NULL_SYM && q->int2 <= 2 &&
+	       is_pure_call(b->quads, i, params)) {
+		// A pure function called with the same arguments as before
+		// gives the same result. The function itself takes the place
+		// of the memory version in the key.
+		arg1 = (q->int2 > 0 ? value_of(b->quads[params[0]]->sym1) : 0);
+		arg2 = (q->int2 > 1 ? value_of(b->quads[params[1]]->sym1) : 0);
+		pos = find_value(op, arg1, arg2, q->sym1);
+		touch(dest);
+		if(pos >= 0 &&
+		   value_nr[values[pos].holder] == values[pos].value) {
+		    q->op_code = (sym_tab->get_symbol_type(dest) == real_type ?
+				  q_rassign : q_iassign);
+		    q->sym1 = values[pos].holder;
+		    q->sym2 = NULL_SYM;
+		    value_nr[dest] = values[pos].value;
+		    // The parameters are all before the call, the last
+		    // argument first, so removing them in this order keeps
+		    // the positions of the ones left right.
+		    for(int p = 0; p < q->int2; p++)
+			b->remove(params[p]);
+		    i -= q->int2;
+		    changed = 1;
+		} else {
+		    value_nr[dest] = ++last_value_nr;
+		    add_value(op, arg1, arg2, q->sym1, dest, value_nr[dest]);
+		}
+		continue;
+	    }
+
+	    // Otherwise, forget what we know about the variables the callee
+	    // may change, and about the arrays it may change.
+	    for(int t = 0; t < nr_touched; t++) {
+		sym_type tag = sym_tab->get_symbol_tag(touched[t]);
+		if((tag == SYM_VAR || tag == SYM_PARAM) &&
+		   !sym_tab->is_temp_var(touched[t]) &&
+		   may_be_written(q->sym1, touched[t]))
+		    value_nr[touched[t]] = 0;
+	    }
+	    if(effects == NULL || !effects->is_complete)
+		clobbered = ++last_memory;
+	    else
+		for(int w = 0; w < effects->nr_writes; w++)
+		    if(sym_tab->get_symbol_tag(effects->writes[w]) ==
+		       SYM_ARRAY) {
+			touch(effects->writes[w]);
+			array_version[effects->writes[w]] = ++last_memory;
+		    }
+	    if(dest != NULL_SYM) {
+		touch(dest);
+		value_nr[dest] = ++last_value_nr;
+	    }
+	    continue;
+
+	default:
+	    // Jumps, labels, parameters and returns compute nothing.
+	    continue;
+	}
+
+	touch(dest);
+	pos = find_value(op, arg1, arg2, memory);
+
+	if(pos >= 0 && value_nr[values[pos].holder] == values[pos].value) {
+	    sym_index holder = values[pos].holder;
+
+	    if(is_stable(holder) && sym_tab->is_temp_var(dest) &&
+	       def_count[dest] == 1 &&
+	       (use_block[dest] == b->nr || use_block[dest] == -1)) {
+		// All reads of dest are later in this block, so we can read
+		// holder there instead and remove the quad entirely.
+		renamed[dest] = holder;
+		b->remove(i--);
+		changed = 1;
+		continue;
+	    }
+
+	    if(op != q_iload && op != q_rload) {
+		// Copying is cheaper than recomputing anything but a load.
+		b->quads[i] = new quadruple((sym_tab->get_symbol_type(dest) ==
+					     real_type ? q_rassign : q_iassign),
+					    holder, NULL_SYM, dest);
+		changed = 1;
+	    }
+	    value_nr[dest] = values[pos].value;
+	} else
+	    value_nr[dest] = add_value(op, arg1, arg2, memory, dest, 0);
+    }
+
+    return changed;
+}
+
+
+
+/************************
+ *** COPY PROPAGATION ***
+ ************************/
+
+
+/* Return a constant symbol of the given type and value. The constants are
+   shared between all routines, since a constant means the same thing
+   everywhere, so we only create a new one the first time a value is
+   needed. */
+sym_index quad_optimizer::constant_for(sym_index type, int value) {
+    for(int i = 0; i < nr_constants; i++) {
+	constant_symbol *con = sym_tab->get_symbol(constants[i])
+	    ->get_constant_symbol();
+	if(con->type == type && con->const_value.ival == value)
+	    return constants[i];
+    }
+
+    if(nr_constants == max_constants) {
+	sym_index *new_constants = new sym_index[max_constants * 2];
+	for(int i = 0; i < nr_constants; i++)
+	    new_constants[i] = constants[i];
+	delete[] constants;
+	constants = new_constants;
+	max_constants *= 2;
+    }
+
+    constants[nr_constants] = sym_tab->gen_temp_const(type, value);
+    return constants[nr_constants++];
+}
+
+
+/* Copy propagation. quads.cc loads every literal into a temporary, and
+   assignments compute their right hand side into a temporary which is then
+   copied to the variable. Both cost the code generator an extra store and
+   load each. We do two things about it:
+
+   A temporary which is assigned once, from a constant or from another such
+   temporary, is removed, and all reads of it read the constant or the other
+   temporary instead. The code generator can load integer constants
+   directly into a register, so that's always a win. Real constants have to
+   go through memory, so we only do it for reals that are read once.
+
+   A temporary which is read only by an assignment right after the quad
+   computing it, is removed by letting that quad compute directly into the
+   assigned variable. */
+int quad_optimizer::copy_propagation() {
+    sym_index uses[MAX_QUAD_USES];
+    int changed = 0;
+    int i, j;
+
+    count_symbols();
+    for(i = 0; i < MAX_SYM; i++)
+	forwarded[i] = NULL_SYM;
+
+    // Find the temporaries we can do without.
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    sym_index dest = q->sym3;
+
+	    if(q->get_def() == NULL_SYM || !is_stable(dest) ||
+	       sym_tab->get_symbol_tag(dest) == SYM_CONST)
+		continue;
+
+	    if(q->op_code == q_iload ||
+	       (q->op_code == q_rload && use_count[dest] <= 1))
+		forwarded[dest] = constant_for(sym_tab->get_symbol_type(dest),
+					       q->int1);
+	    else if((q->op_code == q_iassign || q->op_code == q_rassign) &&
+		    is_stable(q->sym1))
+		forwarded[dest] = q->sym1;
+	    else
+		continue;
+
+	    b->remove(j--);
+	    changed = 1;
+	}
+    }
+
+    // Redirect the reads of them. A temporary can be forwarded to another
+    // one which has been forwarded too, so we follow the chain to its end.
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++) {
+		sym_index sym_p = uses[u];
+		while(sym_p != NULL_SYM && forwarded[sym_p] != NULL_SYM)
+		    sym_p = forwarded[sym_p];
+		if(sym_p != uses[u])
+		    q->replace_use(uses[u], sym_p);
+	    }
+	}
+    }
+
+    // Compute results directly into the variables they are assigned to.
+    count_symbols();
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(j = 0; j + 1 < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    quadruple *next = b->quads[j + 1];
+	    sym_index dest = q->get_def();
+
+	    if(dest != NULL_SYM && sym_tab->is_temp_var(dest) &&
+	       def_count[dest] == 1 && use_count[dest] == 1 &&
+	       (next->op_code == q_iassign || next->op_code == q_rassign) &&
+	       next->sym1 == dest) {
+		q->sym3 = next->sym3;
+		b->remove(j + 1);
+		changed = 1;
+	    }
+	}
+    }
+
+    return changed;
+}
+
+
+
+/*****************************
+ *** DEAD CODE ELIMINATION ***
+ *****************************/
+
+
+/* Remove quads computing temporaries which are never read. Removing one
+   such quad can make the temporaries it read dead too, so we keep going
+   until nothing more is found. A call can't be removed, since the callee
+   may have side effects, but there's no need to store its result. The
+   exception is a call to a pure function, which goes away along with its
+   parameters when its result isn't used. */
+int quad_optimizer::dead_code_elimination() {
+    int *params = NULL;
+    int max_params = 0;
+    int changed = 0;
+    int found;
+
+    for(int i = 0; i < cfg->nr_blocks; i++)
+	if(cfg->blocks[i]->nr_quads > max_params)
+	    max_params = cfg->blocks[i]->nr_quads;
+    params = new int[max_params + 1];
+
+    do {
+	found = 0;
+	count_symbols();
+	for(int i = 0; i < cfg->nr_blocks; i++) {
+	    basic_block *b = cfg->blocks[i];
+	    for(int j = 0; j < b->nr_quads; j++) {
+		quadruple *q = b->quads[j];
+		sym_index dest = q->get_def();
+
+		if(q->op_code == q_call &&
+		   (dest == NULL_SYM || (sym_tab->is_temp_var(dest) &&
+					 use_count[dest] == 0)) &&
+		   is_pure_call(b->quads, j, params)) {
+		    // Nothing is left of what it does, so remove the call
+		    // and its parameters. See local_value_numbering().
+		    int nr_params = q->int2;
+		    for(int p = 0; p < nr_params; p++)
+			b->remove(params[p]);
+		    j -= nr_params;
+		    b->remove(j--);
+		    found = 1;
+		    continue;
+		}
+
+		if(dest == NULL_SYM || !sym_tab->is_temp_var(dest) ||
+		   use_count[dest] != 0)
+		    continue;
+
+		if(q->op_code == q_call)
+		    q->sym3 = NULL_SYM;
+		else
+		    b->remove(j--);
+		found = 1;
+	    }
+	}
+	changed |= found;
+    } while(found);
+
+    delete[] params;
+    return changed;
+}
+
+
+
+/* Remove assignments whose values are never read, now also of the
+   routine's own variables, as found by liveness analysis (see dataflow.hh).
+   This is done last, since the loop optimizations leave such assignments
+   behind, for instance of induction variables only used to end the loop
+   before strength reduction. A call whose result isn't read stays, but
+   doesn't store its result. */
+int quad_optimizer::dead_store_elimination() {
+    int changed = 0;
+    int found;
+
+    do {
+	found = 0;
+	liveness *live = new liveness(cfg);
+	bit_set *live_now = new bit_set(MAX_SYM);
+	for(int i = 0; i < cfg->nr_blocks; i++) {
+	    basic_block *b = cfg->blocks[i];
+	    live_now->copy(live->out[i]);
+	    for(int j = b->nr_quads - 1; j >= 0; j--) {
+		quadruple *q = b->quads[j];
+		sym_index dest = q->get_def();
+
+		if(dest != NULL_SYM && is_scalar_symbol(dest) &&
+		   !live_now->member(dest)) {
+		    found = 1;
+		    if(q->op_code != q_call) {
+			b->remove(j);
+			continue;
+		    }
+		    q->sym3 = NULL_SYM;
+		}
+		live->step_back(q, live_now);
+	    }
+	}
+	delete live_now;
+	delete live;
+	changed |= found;
+    } while(found);
+
+    return changed;
+}
+
+
+
+/*********************************************
+ *** SPARSE CONDITIONAL CONSTANT PROPAGATION ***
+ *********************************************/
+
+
+/* Record that a symbol is read by a quad or a phi node. */
+void quad_optimizer::add_ssa_use(sym_index sym_p, basic_block *b,
+				 quadruple *q, phi_node *phi) {
+    if(nr_ssa_uses == max_ssa_uses) {
+	ssa_use *new_uses = new ssa_use[max_ssa_uses * 2];
+	for(int i = 0; i < nr_ssa_uses; i++)
+	    new_uses[i] = ssa_uses[i];
+	delete[] ssa_uses;
+	ssa_uses = new_uses;
+	max_ssa_uses *= 2;
+    }
+    ssa_uses[nr_ssa_uses].b = b;
+    ssa_uses[nr_ssa_uses].q = q;
+    ssa_uses[nr_ssa_uses].phi = phi;
+    ssa_uses[nr_ssa_uses].next = first_use[sym_p];
+    first_use[sym_p] = nr_ssa_uses++;
+}
+
+
+/* Return the lattice value of a symbol, and the constant in *value if it
+   has one. Integer constants are always CONST, of course. */
+char quad_optimizer::lattice_of(sym_index sym_p, int *value) {
+    if(sym_tab->get_symbol_tag(sym_p) == SYM_CONST) {
+	if(sym_tab->get_symbol_type(sym_p) != integer_type)
+	    return LATTICE_BOTTOM;
+	*value = sym_tab->get_symbol(sym_p)->get_constant_symbol()
+	    ->const_value.ival;
+	return LATTICE_CONST;
+    }
+    *value = lattice_value[sym_p];
+    return lattice[sym_p];
+}
+
+
+/* Move a symbol down the lattice, if the new value is lower than the old.
+   Two different constants meet in BOTTOM. If the value changed, the reads
+   of the symbol have to be visited again. */
+void quad_optimizer::lower(sym_index sym_p, char state, int value) {
+    if(state == LATTICE_CONST && lattice[sym_p] == LATTICE_CONST &&
+       value != lattice_value[sym_p])
+	state = LATTICE_BOTTOM;
+    if(state <= lattice[sym_p])
+	return;
+
+    lattice[sym_p] = state;
+    lattice_value[sym_p] = value;
+    if(!in_sym_work[sym_p]) {
+	in_sym_work[sym_p] = 1;
+	sym_work[nr_sym_work++] = sym_p;
+    }
+}
+
+
+/* Mark the edge to successor nr s of a block as taken. The first time, the
+   successor is put on the flow worklist. */
+void quad_optimizer::mark_edge(basic_block *b, int s) {
+    if(edge_done[b->nr * MAX_SUCCESSORS + s])
+	return;
+    edge_done[b->nr * MAX_SUCCESSORS + s] = 1;
+    flow_work[nr_flow_work++] = b->succ[s];
+}
+
+
+/* Returns 1 if the edge from block p to block b has been taken. */
+int quad_optimizer::edge_taken(basic_block *p, basic_block *b) {
+    for(int s = 0; s < p->nr_succ; s++)
+	if(p->succ[s] == b->nr)
+	    return edge_done[p->nr * MAX_SUCCESSORS + s];
+    return 0;
+}
+
+
+/* The value of a phi node is the meet of the arguments coming in through
+   edges that have been taken. The others may never be, and so don't count
+   yet. */
+void quad_optimizer::visit_phi(basic_block *b, phi_node *phi) {
+    char state = LATTICE_TOP;
+    int result = 0;
+
+    for(int k = 0; k < phi->nr_args && state != LATTICE_BOTTOM; k++) {
+	int value;
+	if(!edge_taken(phi->from[k], b))
+	    continue;
+	switch(lattice_of(phi->args[k], &value)) {
+	case LATTICE_TOP:
+	    break;
+	case LATTICE_CONST:
+	    if(state == LATTICE_TOP) {
+		state = LATTICE_CONST;
+		result = value;
+	    } else if(value != result)
+		state = LATTICE_BOTTOM;
+	    break;
+	default:
+	    state = LATTICE_BOTTOM;
+	}
+    }
+
+    lower(phi->dest, state, result);
+}
+
+
+/* Compute the result of an integer operation on two constants. Returns 0 if
+   it can't be done at compile time, ie, for a division by zero which has
+   to be left to happen at run time. The arithmetic is done on unsigned
+   numbers so overflow wraps around the way it does on the target. */
+static int fold_integer(quad_op_type op, int a, int b, int *result) {
+    unsigned int ua = a, ub = b;
+
+    switch(op) {
+    case q_iassign:
+	*result = a;
+	break;
+    case q_iuminus:
+	*result = (int) (0u - ua);
+	break;
+    case q_inot:
+	*result = (a == 0);
+	break;
+    case q_iplus:
+	*result = (int) (ua + ub);
+	break;
+    case q_iminus:
+	*result = (int) (ua - ub);
+	break;
+    case q_imult:
+	*result = (int) (ua * ub);
+	break;
+    case q_idivide:
+    case q_imod:
+	if(b == 0 || (a == (int) 0x80000000 && b == -1))
+	    return 0;
+	*result = (op == q_idivide ? a / b : a % b);
+	break;
+    case q_ior:
+	*result = (a != 0 || b != 0);
+	break;
+    case q_iand:
+	*result = (a != 0 && b != 0);
+	break;
+    case q_ieq:
+	*result = (a == b);
+	break;
+    case q_ine:
+	*result = (a != b);
+	break;
+    case q_ilt:
+	*result = (a < b);
+	break;
+    case q_igt:
+	*result = (a > b);
+	break;
+    default:
+	return 0;
+    }
+    return 1;
+}
+
+
+/* Evaluate a quad with the lattice values of its arguments. A conditional
+   jump marks the edges it can take, everything else may lower the lattice
+   value of the symbol it assigns. */
+void quad_optimizer::visit_quad(basic_block *b, quadruple *q) {
+    int value1 = 0, value2 = 0, result;
+    char state1, state2;
+
+    if(q->op_code == q_jmpf || q->op_code == q_jmpt) {
+	// Successor 0 is the fall through one, 1 the jump target.
+	state1 = lattice_of(q->sym2, &value1);
+	if(state1 == LATTICE_TOP)
+	    return;
+	if(b->nr_succ == 1)
+	    mark_edge(b, 0);
+	else if(state1 == LATTICE_CONST)
+	    mark_edge(b, (value1 == 0) == (q->op_code == q_jmpf) ? 1 : 0);
+	else {
+	    mark_edge(b, 0);
+	    mark_edge(b, 1);
+	}
+	return;
+    }
+
+    sym_index dest = q->get_def();
+    if(dest == NULL_SYM || lattice[dest] == LATTICE_BOTTOM)
+	return;
+
+    switch(q->op_code) {
+    case q_iload:
+	lower(dest, LATTICE_CONST, q->int1);
+	return;
+    case q_iassign:
+    case q_iuminus:
+    case q_inot:
+	state1 = lattice_of(q->sym1, &value1);
+	state2 = LATTICE_CONST;
+	break;
+    case q_iplus:
+    case q_iminus:
+    case q_imult:
+    case q_idivide:
+    case q_imod:
+    case q_ior:
+    case q_iand:
+    case q_ieq:
+    case q_ine:
+    case q_ilt:
+    case q_igt:
+	state1 = lattice_of(q->sym1, &value1);
+	state2 = lattice_of(q->sym2, &value2);
+	break;
+    default:
+	lower(dest, LATTICE_BOTTOM, 0);
+	return;
+    }
+
+    if(state1 == LATTICE_BOTTOM || state2 == LATTICE_BOTTOM)
+	lower(dest, LATTICE_BOTTOM, 0);
+    else if(state1 == LATTICE_TOP || state2 == LATTICE_TOP)
+	return;
+    else if(fold_integer(q->op_code, value1, value2, &result))
+	lower(dest, LATTICE_CONST, result);
+    else
+	lower(dest, LATTICE_BOTTOM, 0);
+}
+
+
+/* Sparse conditional constant propagation, after Wegman and Zadeck. It
+   works on the SSA form of the routine, and combines two worklists: one of
+   blocks reached through a newly taken edge, and one of symbols whose
+   lattice value has changed. We start with only the first block reached
+   and every symbol at TOP, and only evaluate quads in blocks that have been
+   reached. This way a variable which is assigned a different value only in
+   code which is never run (like the else branch of an if with a constant
+   condition) is still found to be constant, and the never run code is then
+   removed.
+
+   Only integers are tracked: a real constant must be loaded from memory by
+   the code generator anyway, so it's no better than a variable. Symbols
+   which aren't renamed by the SSA form (globals, arrays, variables nested
+   routines can see) are BOTTOM from the start, and so are the values of
+   renamed symbols when the routine is entered. */
+int quad_optimizer::constant_propagation() {
+    int n = cfg->nr_blocks;
+    int changed = 0;
+    int i, j, value;
+    phi_node *phi;
+
+    for(i = 0; i < MAX_SYM; i++) {
+	lattice[i] = LATTICE_BOTTOM;
+	lattice_value[i] = 0;
+	first_use[i] = -1;
+	in_sym_work[i] = 0;
+    }
+    nr_ssa_uses = 0;
+    nr_sym_work = 0;
+
+    // Find the symbols to track, and all reads of them.
+    for(i = 0; i < n; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(phi = b->phis; phi != NULL; phi = phi->next) {
+	    if(sym_tab->get_symbol_type(phi->dest) == integer_type)
+		lattice[phi->dest] = LATTICE_TOP;
+	    for(int k = 0; k < phi->nr_args; k++)
+		add_ssa_use(phi->args[k], b, NULL, phi);
+	}
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    sym_index uses[MAX_QUAD_USES];
+	    sym_index dest = q->get_def();
+	    if(dest != NULL_SYM &&
+	       sym_tab->get_symbol_type(dest) == integer_type &&
+	       (ssa->origin[dest] != NULL_SYM || sym_tab->is_temp_var(dest)))
+		lattice[dest] = LATTICE_TOP;
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++)
+		if(uses[u] != NULL_SYM && (u == 0 || uses[u] != uses[0]))
+		    add_ssa_use(uses[u], b, q, NULL);
+	}
+    }
+
+    block_done = new char[n];
+    edge_done = new char[n * MAX_SUCCESSORS];
+    flow_work = new int[n * MAX_SUCCESSORS + 1];
+    for(i = 0; i < n; i++)
+	block_done[i] = 0;
+    for(i = 0; i < n * MAX_SUCCESSORS; i++)
+	edge_done[i] = 0;
+    nr_flow_work = 0;
+    flow_work[nr_flow_work++] = 0;
+
+    while(nr_flow_work > 0 || nr_sym_work > 0) {
+	if(nr_flow_work > 0) {
+	    basic_block *b = cfg->blocks[flow_work[--nr_flow_work]];
+	    for(phi = b->phis; phi != NULL; phi = phi->next)
+		visit_phi(b, phi);
+	    if(block_done[b->nr])
+		continue;
+	    block_done[b->nr] = 1;
+	    for(j = 0; j < b->nr_quads; j++)
+		visit_quad(b, b->quads[j]);
+	    quadruple *last = b->get_last();
+	    if(last == NULL ||
+	       (last->op_code != q_jmpf && last->op_code != q_jmpt))
+		for(int s = 0; s < b->nr_succ; s++)
+		    mark_edge(b, s);
+	} else {
+	    sym_index sym_p = sym_work[--nr_sym_work];
+	    in_sym_work[sym_p] = 0;
+	    for(int u = first_use[sym_p]; u >= 0; u = ssa_uses[u].next) {
+		if(!block_done[ssa_uses[u].b->nr])
+		    continue;
+		if(ssa_uses[u].phi != NULL)
+		    visit_phi(ssa_uses[u].b, ssa_uses[u].phi);
+		else
+		    visit_quad(ssa_uses[u].b, ssa_uses[u].q);
+	    }
+	}
+    }
+
+    // Now rewrite the code. Reads of constant symbols read the constant
+    // instead, and jumps on constant conditions are folded. Phi arguments
+    // are left alone: a constant there would only turn into a copy when we
+    // leave SSA form, in place of the assignment we would save.
+    for(i = 0; i < n; i++) {
+	basic_block *b = cfg->blocks[i];
+	if(!block_done[i])
+	    continue;
+
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    sym_index uses[MAX_QUAD_USES];
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++)
+		if(uses[u] != NULL_SYM &&
+		   sym_tab->get_symbol_tag(uses[u]) != SYM_CONST &&
+		   lattice_of(uses[u], &value) == LATTICE_CONST) {
+		    q->replace_use(uses[u], constant_for(integer_type, value));
+		    changed = 1;
+		}
+
+	    if((q->op_code == q_jmpf || q->op_code == q_jmpt) &&
+	       sym_tab->get_symbol_tag(q->sym2) == SYM_CONST) {
+		lattice_of(q->sym2, &value);
+		if((value == 0) == (q->op_code == q_jmpf)) {
+		    q->op_code = q_jmp;
+		    q->sym2 = NULL_SYM;
+		} else
+		    b->remove(j--);
+		changed = 1;
+	    }
+	}
+    }
+
+    delete[] block_done;
+    delete[] edge_done;
+    delete[] flow_work;
+
+    if(changed) {
+	cfg->compute_edges();
+	cfg->remove_unreachable();
+	ssa->update_phis();
+    }
+    return changed;
+}
+
+
+
+
+/**********************************
+ *** LOOP INVARIANT CODE MOTION ***
+ **********************************/
+
+
+/* Returns 1 if a quad computes something without side effects, so that it
+   can be moved to before the loop, where it is done even if the loop
+   wouldn't have done it. Array loads aren't, since the loop may store into
+   the array. Divisions are, but only by a constant other than zero, since
+   dividing by zero is a run time error the program may be avoiding. */
+static int is_hoistable(quadruple *q) {
+    switch(q->op_code) {
+    case q_rload:
+    case q_iload:
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_rassign:
+    case q_iassign:
+    case q_lindex:
+    case q_itor:
+	return 1;
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+	if(sym_tab->get_symbol_tag(q->sym2) != SYM_CONST)
+	    return 0;
+	if(sym_tab->get_symbol_type(q->sym2) == real_type)
+	    return sym_tab->get_symbol(q->sym2)->get_constant_symbol()
+		->const_value.rval != 0.0;
+	return sym_tab->get_symbol(q->sym2)->get_constant_symbol()
+	    ->const_value.ival != 0;
+    default:
+	return 0;
+    }
+}
+
+
+/* The loop optimizations. The loops are handled inner first, so that
+   something hoisted out of an inner loop can be hoisted out of the loops
+   around it too. Since a new preheader changes the block numbers, we find
+   the loops again after each one, and remember which ones we've done by
+   their header block. */
+int quad_optimizer::loop_optimization() {
+    basic_block **done = new basic_block *[cfg->nr_blocks];
+    int nr_done = 0;
+    int changed = 0;
+
+    while(1) {
+	dominator_tree *dom = new dominator_tree(cfg);
+	loop_nest *nest = new loop_nest(cfg, dom);
+	natural_loop *loop = NULL;
+
+	for(int i = 0; i < nest->nr_loops && loop == NULL; i++) {
+	    int j;
+	    for(j = 0; j < nr_done; j++)
+		if(done[j] == cfg->blocks[nest->loops[i]->header])
+		    break;
+	    if(j == nr_done)
+		loop = nest->loops[i];
+	}
+
+	if(loop != NULL) {
+	    done[nr_done++] = cfg->blocks[loop->header];
+	    changed |= optimize_loop(loop);
+	}
+
+	delete nest;
+	delete dom;
+	if(loop == NULL)
+	    break;
+    }
+
+    delete[] done;
+    return changed;
+}
+
+
+/* Optimize one loop. We collect the blocks of the loop and find out which
+   symbols it may change, give it a preheader, and then run the passes on
+   it. Both passes need to know what is invariant in the loop, ie, which
+   symbols it doesn't assign, and which no call in it may assign. */
+int quad_optimizer::optimize_loop(natural_loop *loop) {
+    bit_set *read = new bit_set(MAX_SYM);
+    sym_index uses[MAX_QUAD_USES];
+    int nr_quads = 0;
+    int changed = 0;
+    int i, j, u, c;
+
+    loop_blocks = new basic_block *[loop->nr_body];
+    nr_loop_blocks = 0;
+    for(i = 0; i < cfg->nr_blocks; i++)
+	if(loop->body[i]) {
+	    loop_blocks[nr_loop_blocks++] = cfg->blocks[i];
+	    nr_quads += cfg->blocks[i]->nr_quads;
+	}
+
+    assigned = new bit_set(MAX_SYM);
+    callees = new sym_index[nr_quads + 1];
+    nr_callees = 0;
+    for(i = 0; i < nr_loop_blocks; i++)
+	for(j = 0; j < loop_blocks[i]->nr_quads; j++) {
+	    quadruple *q = loop_blocks[i]->quads[j];
+	    if(q->get_def() != NULL_SYM)
+		assigned->add(q->get_def());
+	    if(q->op_code == q_call)
+		callees[nr_callees++] = q->sym1;
+	    int nr_uses = q->get_uses(uses);
+	    for(u = 0; u < nr_uses; u++)
+		if(uses[u] != NULL_SYM)
+		    read->add(uses[u]);
+	}
+
+    preheader = cfg->insert_preheader(loop);
+
+    // Variables the calls in the loop may change are assigned in the loop
+    // as far as we are concerned.
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++) {
+	if(!read->member(sym_p) || assigned->member(sym_p) ||
+	   sym_tab->get_symbol_tag(sym_p) == SYM_CONST ||
+	   sym_tab->is_temp_var(sym_p))
+	    continue;
+	for(c = 0; c < nr_callees; c++)
+	    if(may_be_written(callees[c], sym_p))
+		assigned->add(sym_p);
+    }
+
+    changed |= hoist_invariants(read);
+    changed |= reduce_strength();
+    changed |= unroll_loop();
+
+    delete[] loop_blocks;
+    delete[] callees;
+    delete assigned;
+    delete read;
+    loop_blocks = NULL;
+    callees = NULL;
+    assigned = NULL;
+    preheader = NULL;
+    return changed;
+}
+
+
+/* Returns 1 if a symbol holds the same value everywhere in the current
+   loop. */
+int quad_optimizer::is_invariant(sym_index sym_p) {
+    return sym_tab->get_symbol_tag(sym_p) == SYM_CONST ||
+	!assigned->member(sym_p);
+}
+
+
+/* Hoist the invariant computations out of the current loop. A quad is
+   moved if it is hoistable, all its operands are invariant and it assigns
+   a temporary which is assigned nowhere else (so the temporary becomes
+   invariant too, which may make more quads invariant).
+
+   Before that, variables declared outside the routine which are read (arg
+   1) and invariant in the loop are copied into temporaries in the
+   preheader, and read from there in the loop. They are reached through the
+   display, so if the temporary is kept in a register, this saves a load in
+   every iteration. */
+int quad_optimizer::hoist_invariants(bit_set *read) {
+    sym_index uses[MAX_QUAD_USES];
+    int changed = 0;
+    int found;
+    int i, j, u;
+
+    // Copy invariant variables from outer routines into temporaries.
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++) {
+	if(!read->member(sym_p) || assigned->member(sym_p) ||
+	   !is_scalar_symbol(sym_p) || sym_tab->is_temp_var(sym_p) ||
+	   sym_tab->get_symbol(sym_p)->level > cfg->env->level)
+	    continue;
+
+	sym_index type = sym_tab->get_symbol_type(sym_p);
+	sym_index temp = sym_tab->gen_temp_var(type);
+	preheader->append(new quadruple(type == real_type ? q_rassign
+					: q_iassign, sym_p, NULL_SYM, temp));
+	for(i = 0; i < nr_loop_blocks; i++)
+	    for(j = 0; j < loop_blocks[i]->nr_quads; j++)
+		loop_blocks[i]->quads[j]->replace_use(sym_p, temp);
+	changed = 1;
+    }
+
+    // Hoist the invariant quads, until no more are found.
+    count_symbols();
+    do {
+	found = 0;
+	for(i = 0; i < nr_loop_blocks; i++) {
+	    basic_block *b = loop_blocks[i];
+	    for(j = 0; j < b->nr_quads; j++) {
+		quadruple *q = b->quads[j];
+		sym_index dest = q->get_def();
+
+		if(!is_hoistable(q) || !sym_tab->is_temp_var(dest) ||
+		   def_count[dest] != 1)
+		    continue;
+
+		int nr_uses = q->get_uses(uses);
+		for(u = 0; u < nr_uses; u++)
+		    if(uses[u] != NULL_SYM && !is_invariant(uses[u]))
+			break;
+		if(u < nr_uses)
+		    continue;
+
+		b->remove(j--);
+		preheader->append(q);
+		assigned->remove(dest);
+		found = 1;
+	    }
+	}
+	changed |= found;
+    } while(found);
+
+    return changed;
+}
+
+
+
+
+/**************************
+ *** STRENGTH REDUCTION ***
+ **************************/
+
+
+/* Return the position of a quad in a block, or -1 if it isn't there. */
+static int position_of(basic_block *b, quadruple *q) {
+    for(int i = 0; i < b->nr_quads; i++)
+	if(b->quads[i] == q)
+	    return i;
+    return -1;
+}
+
+
+/* Find the basic induction variables of the current loop. A basic
+   induction variable is a variable which is assigned exactly once in the
+   loop, by a quad adding an invariant step to it or subtracting one from it:
+
+       q_iplus    I          $12        I
+
+   No call in the loop may see it, since the pointers we derive from it
+   must change together with it. */
+void quad_optimizer::find_induction_variables() {
+    nr_ivs = 0;
+    for(int i = 0; i < nr_loop_blocks; i++) {
+	basic_block *b = loop_blocks[i];
+	for(int j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    sym_index var = q->sym3;
+	    sym_index step;
+
+	    if(q->op_code != q_iplus && q->op_code != q_iminus)
+		continue;
+	    sym_type tag = sym_tab->get_symbol_tag(var);
+	    if(tag != SYM_VAR && tag != SYM_PARAM)
+		continue;
+
+	    if(q->sym1 == var && is_invariant(q->sym2))
+		step = q->sym2;
+	    else if(q->op_code == q_iplus && q->sym2 == var &&
+		    is_invariant(q->sym1))
+		step = q->sym1;
+	    else
+		continue;
+
+	    int c;
+	    for(c = 0; c < nr_callees; c++)
+		if(may_be_accessed(callees[c], var))
+		    break;
+	    if(c < nr_callees)
+		continue;
+
+	    int nr_defs = 0;
+	    for(int k = 0; k < nr_loop_blocks; k++)
+		for(int l = 0; l < loop_blocks[k]->nr_quads; l++)
+		    if(loop_blocks[k]->quads[l]->get_def() == var)
+			nr_defs++;
+	    if(nr_defs != 1)
+		continue;
+
+	    ivs[nr_ivs].sym = var;
+	    ivs[nr_ivs].step_quad = q;
+	    ivs[nr_ivs].block = b;
+	    ivs[nr_ivs].step = step;
+	    ivs[nr_ivs].step4 = NULL_SYM;
+	    nr_ivs++;
+	}
+    }
+}
+
+
+/* Return the index of a symbol in the induction variable table, or -1 if
+   it isn't an induction variable. */
+int quad_optimizer::find_induction_variable(sym_index sym_p) {
+    for(int i = 0; i < nr_ivs; i++)
+	if(ivs[i].sym == sym_p)
+	    return i;
+    return -1;
+}
+
+
+/* Return the pointer holding the address of array[iv op offset], creating
+   it if there isn't one yet. A new pointer is set up in the preheader. */
+int quad_optimizer::find_pointer(sym_index array, int iv, quad_op_type op,
+				 sym_index offset) {
+    int p;
+
+    for(p = 0; p < nr_pointers; p++)
+	if(pointers[p].array == array && pointers[p].iv == iv &&
+	   pointers[p].op == op && pointers[p].offset == offset)
+	    return p;
+
+    sym_index pointer = sym_tab->gen_temp_var(integer_type);
+    if(offset == NULL_SYM)
+	preheader->append(new quadruple(q_lindex, array, ivs[iv].sym,
+					pointer));
+    else {
+	sym_index index = sym_tab->gen_temp_var(integer_type);
+	preheader->append(new quadruple(op, ivs[iv].sym, offset, index));
+	preheader->append(new quadruple(q_lindex, array, index, pointer));
+    }
+
+    pointers[p].array = array;
+    pointers[p].iv = iv;
+    pointers[p].op = op;
+    pointers[p].offset = offset;
+    pointers[p].pointer = pointer;
+    pointers[p].in_step_block = 0;
+    nr_pointers++;
+    return p;
+}
+
+
+/* Return a symbol holding the step of an induction variable times 4, ie,
+   the step of the pointers derived from it. If the step isn't a constant,
+   it is computed in the preheader (by adding, since multiplication is a
+   call to the glue code). */
+sym_index quad_optimizer::pointer_step(int iv) {
+    induction_variable *v = &ivs[iv];
+
+    if(v->step4 != NULL_SYM)
+	return v->step4;
+
+    if(sym_tab->get_symbol_tag(v->step) == SYM_CONST) {
+	unsigned int step = sym_tab->get_symbol(v->step)
+	    ->get_constant_symbol()->const_value.ival;
+	v->step4 = constant_for(integer_type, (int)(step * 4));
+    } else {
+	sym_index step2 = sym_tab->gen_temp_var(integer_type);
+	v->step4 = sym_tab->gen_temp_var(integer_type);
+	preheader->append(new quadruple(q_iplus, v->step, v->step, step2));
+	preheader->append(new quadruple(q_iplus, step2, step2, v->step4));
+    }
+    return v->step4;
+}
+
+
+/* Returns 1 if a block is part of the current loop. */
+int quad_optimizer::in_loop(basic_block *b) {
+    for(int i = 0; i < nr_loop_blocks; i++)
+	if(loop_blocks[i] == b)
+	    return 1;
+    return 0;
+}
+
+
+/* Returns 1 if a quad indexes an array with a given symbol. */
+static int is_index_quad(quadruple *q, sym_index index) {
+    return (q->op_code == q_lindex || q->op_code == q_irindex ||
+	    q->op_code == q_rrindex) && q->sym2 == index;
+}
+
+
+/* Returns 1 if an induction variable can be removed from the loop, ie, if
+   the loop only uses it to index arrays, and to decide whether to go on, as
+   in
+
+       q_lindex   FLAGS      I          $30
+       q_istore   TRUE       -          $30
+       q_iplus    I          $31        I
+       q_ilt      I          SIZE       $32
+       q_jmpt     84         $32        -
+
+   Then we can step a pointer to FLAGS[I] instead, compare it with the
+   address of FLAGS[SIZE], and forget about I (provided it isn't read after
+   the loop either). Other induction variables may get pointers too, but
+   they have to be stepped as well (see reduce_strength()).
+
+   A pointer comparison only means the same thing as the index comparison
+   if the addresses don't wrap around, ie, stay close to the array. So we
+   only do this for an upward step and a constant bound no larger than an
+   array which is indexed with the variable in the same block as the step,
+   before it: then every iteration indexes that array with the old value of
+   the variable. */
+int quad_optimizer::is_removable(int iv, liveness *live) {
+    induction_variable *v = &ivs[iv];
+    sym_index uses[MAX_QUAD_USES];
+    quadruple *test = NULL;
+    sym_index bound = NULL_SYM;
+    int max_bound = -1;
+    int step_pos = position_of(v->block, v->step_quad);
+    int i, j, k, u;
+
+    if(v->step_quad->op_code != q_iplus ||
+       sym_tab->get_symbol_tag(v->step) != SYM_CONST ||
+       sym_tab->get_symbol(v->step)->get_constant_symbol()
+       ->const_value.ival <= 0)
+	return 0;
+
+    for(i = 0; i < nr_loop_blocks; i++) {
+	basic_block *b = loop_blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    if(q == v->step_quad)
+		continue;
+	    int nr_uses = q->get_uses(uses);
+	    for(u = 0; u < nr_uses; u++)
+		if(uses[u] == v->sym)
+		    break;
+	    if(u == nr_uses)
+		continue;
+
+	    if(is_index_quad(q, v->sym)) {
+		int size = sym_tab->get_symbol(q->sym1)->get_array_symbol()
+		    ->array_cardinality;
+		if(b == v->block && j < step_pos && size > max_bound)
+		    max_bound = size;
+	    } else if((q->op_code == q_iplus || q->op_code == q_iminus) &&
+		      sym_tab->is_temp_var(q->sym3) &&
+		      def_count[q->sym3] == 1 &&
+		      ((q->sym1 == v->sym && is_invariant(q->sym2)) ||
+		       (q->op_code == q_iplus && q->sym2 == v->sym &&
+			is_invariant(q->sym1)))) {
+		// An index iv + c. It must only be read by index quads later
+		// in the block, before the step.
+		int nr_indexed = 0;
+		int end = (b == v->block && step_pos > j ? step_pos :
+			   b->nr_quads);
+		for(k = j + 1; k < end; k++)
+		    if(is_index_quad(b->quads[k], q->sym3))
+			nr_indexed++;
+		if(nr_indexed != use_count[q->sym3])
+		    return 0;
+	    } else if(test == NULL && b == v->block && j > step_pos &&
+		      q->op_code == q_ilt && q->sym1 == v->sym &&
+		      q->sym2 != v->sym)
+		test = q;
+	    else if(test == NULL && b == v->block && j > step_pos &&
+		    q->op_code == q_igt && q->sym2 == v->sym &&
+		    q->sym1 != v->sym)
+		test = q;
+	    else
+		return 0;
+	}
+    }
+
+    if(test == NULL)
+	return 0;
+    bound = (test->op_code == q_ilt ? test->sym2 : test->sym1);
+    if(sym_tab->get_symbol_tag(bound) != SYM_CONST)
+	return 0;
+    int limit = sym_tab->get_symbol(bound)->get_constant_symbol()
+	->const_value.ival;
+    if(limit < 0 || limit > max_bound)
+	return 0;
+
+    for(i = 0; i < nr_loop_blocks; i++)
+	for(j = 0; j < loop_blocks[i]->nr_succ; j++) {
+	    basic_block *succ = cfg->blocks[loop_blocks[i]->succ[j]];
+	    if(!in_loop(succ) && live->in[succ->nr]->member(v->sym))
+		return 0;
+	}
+
+    v->test = test;
+    v->bound = bound;
+    return 1;
+}
+
+
+/* Remove an induction variable from the loop, once all its index quads
+   have been changed to use pointers. The exit test is changed to compare
+   one of the pointers instead (see is_removable). */
+void quad_optimizer::replace_exit_test(int iv) {
+    induction_variable *v = &ivs[iv];
+    quadruple *test = v->test;
+    int limit = sym_tab->get_symbol(v->bound)->get_constant_symbol()
+	->const_value.ival;
+    int p;
+
+    for(p = 0; p < nr_pointers; p++)
+	if(pointers[p].iv == iv && pointers[p].offset == NULL_SYM &&
+	   pointers[p].in_step_block &&
+	   sym_tab->get_symbol(pointers[p].array)->get_array_symbol()
+	   ->array_cardinality >= limit)
+	    break;
+    if(p == nr_pointers)
+	fatal("quad_optimizer::replace_exit_test(): no pointer to compare");
+
+    sym_index end = sym_tab->gen_temp_var(integer_type);
+    preheader->append(new quadruple(q_lindex, pointers[p].array, v->bound,
+				    end));
+    if(test->op_code == q_ilt) {
+	test->sym1 = pointers[p].pointer;
+	test->sym2 = end;
+    } else {
+	test->sym1 = end;
+	test->sym2 = pointers[p].pointer;
+    }
+    v->block->remove(position_of(v->block, v->step_quad));
+}
+
+
+/* Strength reduction of array indexing in the current loop. Every access
+   to an array element costs a shift and an add to compute the address
+   from the index, and the index is typically an induction variable, as I
+   in
+
+       while i < SIZE do
+           flags[i] := TRUE;
+           i := i + 1;
+       end;
+
+   Instead we keep the address of the element in a pointer temporary,
+   which is set up in the preheader and stepped by 4 times the step of the
+   variable, right after the variable itself is stepped. Loads through the
+   pointer become q_ifetch/q_rfetch, and stores use it directly, with no
+   address arithmetic at all. Indexes of the form iv + c or iv - c (c
+   invariant) computed in the same block get pointers of their own.
+   Finally the variable is removed from the loop if nothing else needs it
+   (see is_removable()), so the loop above becomes a store, a pointer
+   increment and a comparison.
+
+   A variable which has to stay is only worth pointers if they save more
+   than it costs to step them. Each access through a pointer saves the
+   shift and the computation of the array's address. Stepping a pointer by
+   4 times a variable, which is computed in the preheader, is a single add,
+   but a constant step has to be set in a register first (see codegen.cc).
+   That costs as much as an access saves, and the access may not even be
+   made every time round. So such a variable is only
+   reduced if it is stepped by a variable, as K in
+
+       while k < SIZE do
+           flags[k] := FALSE;
+           k := k + prime;
+       end; */
+int quad_optimizer::reduce_strength() {
+    sym_index uses[MAX_QUAD_USES];
+    int nr_quads = 0;
+    int changed = 0;
+    int i, j, k, u;
+
+    for(i = 0; i < nr_loop_blocks; i++)
+	nr_quads += loop_blocks[i]->nr_quads;
+    ivs = new induction_variable[nr_quads + 1];
+    pointers = new derived_pointer[nr_quads + 1];
+    nr_pointers = 0;
+
+    find_induction_variables();
+    count_symbols();
+
+    // Keep the induction variables worth reducing.
+    liveness *live = new liveness(cfg);
+    for(i = j = 0; i < nr_ivs; i++) {
+	ivs[i].removable = is_removable(i, live);
+	if(ivs[i].removable ||
+	   sym_tab->get_symbol_tag(ivs[i].step) != SYM_CONST)
+	    ivs[j++] = ivs[i];
+    }
+    nr_ivs = j;
+    delete live;
+
+    for(i = 0; i < nr_loop_blocks && nr_ivs > 0; i++) {
+	basic_block *b = loop_blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    quad_op_type op = q_iplus;
+	    sym_index offset = NULL_SYM;
+
+	    if(q->op_code != q_lindex && q->op_code != q_irindex &&
+	       q->op_code != q_rrindex)
+		continue;
+
+	    // Find out if the index is iv, or iv + c or iv - c.
+	    int iv = find_induction_variable(q->sym2);
+	    if(iv < 0) {
+		if(!sym_tab->is_temp_var(q->sym2) || def_count[q->sym2] != 1)
+		    continue;
+		for(k = j - 1; k >= 0; k--)
+		    if(b->quads[k]->get_def() == q->sym2)
+			break;
+		if(k < 0)
+		    continue;
+
+		quadruple *def = b->quads[k];
+		if(def->op_code != q_iplus && def->op_code != q_iminus)
+		    continue;
+		op = def->op_code;
+		if(find_induction_variable(def->sym1) >= 0 &&
+		   is_invariant(def->sym2)) {
+		    iv = find_induction_variable(def->sym1);
+		    offset = def->sym2;
+		} else if(op == q_iplus &&
+			  find_induction_variable(def->sym2) >= 0 &&
+			  is_invariant(def->sym1)) {
+		    iv = find_induction_variable(def->sym2);
+		    offset = def->sym1;
+		} else
+		    continue;
+
+		// The variable mustn't be stepped in between.
+		int step_pos = position_of(b, ivs[iv].step_quad);
+		if(step_pos > k && step_pos < j)
+		    continue;
+	    }
+
+	    int p = find_pointer(q->sym1, iv, op, offset);
+	    sym_index pointer = pointers[p].pointer;
+	    int step_pos = position_of(b, ivs[iv].step_quad);
+	    if(step_pos > j && offset == NULL_SYM)
+		pointers[p].in_step_block = 1;
+
+	    if(q->op_code == q_lindex) {
+		// The address is only needed by stores. Let the ones before
+		// the step read the pointer directly.
+		sym_index address = q->sym3;
+		int nr_replaced = 0;
+		int end = (step_pos > j ? step_pos : b->nr_quads);
+		for(k = j + 1; k < end; k++) {
+		    int nr_uses = b->quads[k]->get_uses(uses);
+		    for(u = 0; u < nr_uses; u++)
+			if(uses[u] == address)
+			    break;
+		    if(u < nr_uses) {
+			b->quads[k]->replace_use(address, pointer);
+			nr_replaced++;
+		    }
+		}
+		if(sym_tab->is_temp_var(address) && def_count[address] == 1 &&
+		   nr_replaced == use_count[address])
+		    b->remove(j--);
+		else
+		    b->quads[j] = new quadruple(q_iassign, pointer, NULL_SYM,
+						address);
+	    } else
+		b->quads[j] = new quadruple((q->op_code == q_irindex ?
+					     q_ifetch : q_rfetch),
+					    pointer, NULL_SYM, q->sym3);
+	    changed = 1;
+	}
+    }
+
+    // Step the pointers along with their variables.
+    for(int p = 0; p < nr_pointers; p++) {
+	induction_variable *v = &ivs[pointers[p].iv];
+	v->block->insert(position_of(v->block, v->step_quad) + 1,
+			 new quadruple(v->step_quad->op_code,
+				       pointers[p].pointer,
+				       pointer_step(pointers[p].iv),
+				       pointers[p].pointer));
+    }
+
+    // The computations of iv + c are dead now, so the variables which can
+    // be removed are only read by their exit tests.
+    if(changed)
+	dead_code_elimination();
+    for(i = 0; i < nr_ivs; i++)
+	if(ivs[i].removable)
+	    replace_exit_test(i);
+
+    delete[] ivs;
+    delete[] pointers;
+    ivs = NULL;
+    pointers = NULL;
+    return changed;
+}
+
+
+
+
+/**********************
+ *** LOOP UNROLLING ***
+ **********************/
+
+
+/* Find out which value a symbol has just before a quad, if it is a
+   constant, or the address of an array element with a constant index. The
+   value is the constant or the byte offset from the start of the array,
+   and the array is NULL_SYM if there isn't one. We look backwards from the
+   quad through blocks with a single predecessor, so that we only follow
+   code which is sure to have been run. Returns 1 if the value was found. */
+int quad_optimizer::value_before(basic_block *b, int pos, sym_index sym_p,
+				 sym_index *array, int *value) {
+    sym_index array2;
+    int value2;
+
+    if(sym_tab->get_symbol_tag(sym_p) == SYM_CONST) {
+	if(sym_tab->get_symbol_type(sym_p) != integer_type)
+	    return 0;
+	*array = NULL_SYM;
+	*value = sym_tab->get_symbol(sym_p)->get_constant_symbol()
+	    ->const_value.ival;
+	return 1;
+    }
+
+    // A limit on the number of blocks we look through, since a chain of
+    // blocks with a single predecessor may be a cycle.
+    for(int nr_blocks = 0; nr_blocks < cfg->nr_blocks; nr_blocks++) {
+	for(int i = pos - 1; i >= 0; i--) {
+	    quadruple *q = b->quads[i];
+
+	    if(q->op_code == q_call && may_be_written(q->sym1, sym_p))
+		return 0;
+	    if(q->get_def() != sym_p)
+		continue;
+
+	    switch(q->op_code) {
+	    case q_iload:
+		*array = NULL_SYM;
+		*value = q->int1;
+		return 1;
+	    case q_iassign:
+		return value_before(b, i, q->sym1, array, value);
+	    case q_lindex:
+		if(!value_before(b, i, q->sym2, &array2, &value2) ||
+		   array2 != NULL_SYM)
+		    return 0;
+		*array = q->sym1;
+		*value = 4 * value2;
+		return 1;
+	    case q_iplus:
+	    case q_iminus:
+		if(!value_before(b, i, q->sym1, array, value) ||
+		   !value_before(b, i, q->sym2, &array2, &value2))
+		    return 0;
+		if(q->op_code == q_iminus && array2 == NULL_SYM)
+		    *value -= value2;
+		else if(q->op_code == q_iplus && *array == NULL_SYM) {
+		    *array = array2;
+		    *value += value2;
+		} else if(q->op_code == q_iplus && array2 == NULL_SYM)
+		    *value += value2;
+		else
+		    return 0;
+		return 1;
+	    default:
+		return 0;
+	    }
+	}
+
+	if(b->nr_pred != 1)
+	    return 0;
+	b = cfg->blocks[b->pred[0]];
+	pos = b->nr_quads;
+    }
+    return 0;
+}
+
+
+/* Append a copy of some quads to a block, leaving out one of them. */
+static void append_copy(basic_block *to, quadruple **quads, int nr_quads,
+			quadruple *skip) {
+    for(int i = 0; i < nr_quads; i++)
+	if(quads[i] != skip)
+	    to->append(new quadruple(*quads[i]));
+}
+
+
+/* Unroll the current loop, if it is a counted loop. After the rotation in
+   quads.cc and the passes above, a counted loop is a single block looking
+   like
+
+       q_labl     84         -          -
+       ...
+       q_iplus    I          $12        I
+       ...
+       q_ilt      I          SIZE       $14
+       q_jmpt     84         $14        -
+
+   where I is only assigned by the step (a constant), and both the value I
+   has when the loop is entered and SIZE are known (see value_before; I may
+   also be a pointer made by strength reduction). Then we know how many
+   times the loop will run, n. The loop is always entered at the top, so it
+   runs at least once.
+
+   If n is no larger than the unroll factor (the -u flag), the loop is
+   unrolled completely: its body is repeated n times, with no test or jump.
+   Otherwise the body is repeated unroll factor times in the loop, with the
+   test only in the last copy, and the n % factor remaining rounds are done
+   by copies placed in the preheader. This saves the test, the jump and its
+   delay slot nop in all but one of the copies.
+
+   Since the copies are run in the same order as the rounds of the loop
+   would be, they can simply reuse the same symbols. */
+int quad_optimizer::unroll_loop() {
+    if(unroll_factor < 2 || nr_loop_blocks != 1)
+	return 0;
+
+    basic_block *b = loop_blocks[0];
+    int nr_quads = b->nr_quads;
+    if(nr_quads < 3 || b->get_label() < 0)
+	return 0;
+
+    quadruple *jump = b->quads[nr_quads - 1];
+    quadruple *test = b->quads[nr_quads - 2];
+    if(jump->op_code != q_jmpt || jump->int1 != b->get_label() ||
+       test->sym3 != jump->sym2 || !sym_tab->is_temp_var(test->sym3) ||
+       (test->op_code != q_ilt && test->op_code != q_igt))
+	return 0;
+
+    count_symbols();
+    if(use_count[test->sym3] != 1)
+	return 0;
+
+    // Find out which side of the test is the counter. The test goes on
+    // while counter < bound (or counter > bound).
+    sym_index counter = NULL_SYM;
+    sym_index bound = NULL_SYM;
+    quadruple *step_quad = NULL;
+    int below = (test->op_code == q_ilt);
+    int i, nr_defs;
+
+    for(int side = 0; side < 2 && step_quad == NULL; side++) {
+	counter = (side == 0 ? test->sym1 : test->sym2);
+	bound = (side == 0 ? test->sym2 : test->sym1);
+	nr_defs = 0;
+	for(i = 1; i < nr_quads; i++) {
+	    quadruple *q = b->quads[i];
+	    if(q->get_def() == counter) {
+		nr_defs++;
+		step_quad = q;
+	    }
+	}
+	if(nr_defs != 1 || !is_invariant(bound) ||
+	   (step_quad->op_code != q_iplus && step_quad->op_code != q_iminus) ||
+	   (step_quad->sym1 != counter && (step_quad->op_code != q_iplus ||
+					   step_quad->sym2 != counter)) ||
+	   sym_tab->get_symbol_tag(step_quad->sym1 == counter ?
+				   step_quad->sym2 : step_quad->sym1) !=
+	   SYM_CONST)
+	    step_quad = NULL;
+	if(side == 1)
+	    below = !below;
+    }
+    if(step_quad == NULL)
+	return 0;
+
+    for(int c = 0; c < nr_callees; c++)
+	if(may_be_written(callees[c], counter))
+	    return 0;
+
+    // Compute the number of rounds.
+    sym_index start_array, end_array;
+    int start, end;
+    if(!value_before(preheader, preheader->nr_quads, counter, &start_array,
+		     &start) ||
+       !value_before(preheader, preheader->nr_quads, bound, &end_array,
+		     &end) ||
+       start_array != end_array)
+	return 0;
+
+    long step = sym_tab->get_symbol(step_quad->sym1 == counter ?
+				    step_quad->sym2 : step_quad->sym1)
+	->get_constant_symbol()->const_value.ival;
+    if(step_quad->op_code == q_iminus)
+	step = -step;
+
+    long distance = (below ? (long)end - start : (long)start - end);
+    if(!below)
+	step = -step;
+    if(step <= 0)
+	return 0;
+    long rounds = (distance <= 0 ? 1 : (distance + step - 1) / step);
+
+    // The body, ie, the quads between the label and the test.
+    int nr_body = nr_quads - 3;
+    quadruple **body = new quadruple *[nr_body + 1];
+    for(i = 0; i < nr_body; i++)
+	body[i] = b->quads[i + 1];
+
+    if(nr_body * unroll_factor > MAX_UNROLLED_QUADS) {
+	delete[] body;
+	return 0;
+    }
+
+    // Rebuild the loop block from its label.
+    while(b->nr_quads > 1)
+	b->remove(b->nr_quads - 1);
+
+    if(rounds <= unroll_factor) {
+	for(i = 0; i < rounds; i++)
+	    append_copy(b, body, nr_body, NULL);
+	cfg->compute_edges();
+    } else {
+	for(i = 0; i < rounds % unroll_factor; i++)
+	    append_copy(preheader, body, nr_body, NULL);
+	for(i = 0; i < unroll_factor - 1; i++)
+	    append_copy(b, body, nr_body, NULL);
+	for(i = 0; i < nr_body; i++)
+	    b->append(body[i]);
+	b->append(test);
+	b->append(jump);
+    }
+
+    delete[] body;
+    return 1;
+}
+
+
+
+/*******************************
+ *** FUSED CONDITIONAL JUMPS ***
+ *******************************/
+
+
+/* quads.cc turns a condition into a relation computing 0 or 1 into a
+   temporary, which q_jmpf (or q_jmpt) then tests. The code generator makes
+   a truth value of the relation with a compare, a branch and two movs,
+   only to test it again. When the temporary is read by nothing but a jump
+   right after the relation, the two quads are replaced by one of the
+   conditional jumps of quads.hh, which becomes a single compare and branch.
+
+   This is done last, on the quads about to be turned into assembler, so
+   none of the passes above have to know about those jumps. The quads kept
+   for inlining and whole program optimization are the ones from before. */
+
+
+/* Return the conditional jump a relation followed by q_jmpt (if_true) or
+   q_jmpf becomes, or q_nop if the quad isn't a relation. */
+static quad_op_type fused_jump(quad_op_type relation, int if_true) {
+    switch(relation) {
+    case q_ieq:
+	return (if_true ? q_jieq : q_jine);
+    case q_ine:
+	return (if_true ? q_jine : q_jieq);
+    case q_ilt:
+	return (if_true ? q_jilt : q_jige);
+    case q_igt:
+	return (if_true ? q_jigt : q_jile);
+    case q_req:
+	return (if_true ? q_jreq : q_jrne);
+    case q_rne:
+	return (if_true ? q_jrne : q_jreq);
+    case q_rlt:
+	return (if_true ? q_jrlt : q_jrge);
+    case q_rgt:
+	return (if_true ? q_jrgt : q_jrle);
+    default:
+	return q_nop;
+    }
+}
+
+
+/* Return the quads of a routine with the relations only read by the jump
+   after them fused with it, as described above. */
+quad_list *quad_optimizer::fuse_conditional_jumps(quad_list *q_list) {
+    sym_index uses[MAX_QUAD_USES];
+    quadruple *q, *next;
+    int i;
+
+    for(i = 0; i < MAX_SYM; i++)
+	use_count[i] = 0;
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next()) {
+	int nr_uses = q->get_uses(uses);
+	for(i = 0; i < nr_uses; i++)
+	    if(uses[i] != NULL_SYM)
+		use_count[uses[i]]++;
+    }
+    delete ql_iterator;
+
+    quad_list *result = new quad_list(q_list->last_label);
+    ql_iterator = new quad_list_iterator(q_list);
+    q = ql_iterator->get_current();
+    while(q != NULL) {
+	next = ql_iterator->get_next();
+	if(next != NULL &&
+	   (next->op_code == q_jmpf || next->op_code == q_jmpt) &&
+	   fused_jump(q->op_code, 0) != q_nop && next->sym2 == q->sym3 &&
+	   sym_tab->is_temp_var(q->sym3) && use_count[q->sym3] == 1) {
+	    quadruple *jump =
+		new quadruple(fused_jump(q->op_code, next->op_code == q_jmpt),
+			      q->sym1, q->sym2, NULL_SYM);
+	    jump->int3 = next->int1;
+	    *result += jump;
+	    q = ql_iterator->get_next();
+	    continue;
+	}
+	*result += q;
+	q = next;
+    }
+    delete ql_iterator;
+    return result;
+}
+
+
+
+/********************************************
+ *** FRAME LAYOUT AND REGISTER ALLOCATION ***
+ ********************************************/
+
+
+/* symtab.cc gives every variable, array and temporary of a routine a slot
+   of its own in the activation record as it is declared or generated, and
+   the slots of the ones the optimizer has done away with stay. Once a
+   routine is optimized, we decide where its symbols should be kept for
+   real: some of them in registers, and the rest in an activation record
+   laid out again with room only for the symbols its quads still mention,
+   so that its frame is smaller and more of the offsets fit in the
+   instructions (see fetch() and store() in codegen.cc).
+
+   A variable used by a routine nested inside the one it belongs to has to
+   stay where it is, though, since the nested routine has been turned into
+   assembler already, and reaches it through the display. The nested
+   routines are always optimized first, so note_outer_references() can
+   collect those variables as it goes. The other symbols are packed around
+   them, in the order they were declared. Parameters live in the caller's
+   frame, and are left alone.
+
+   Both registers and slots are handed out after the live ranges of the
+   symbols. The ranges are taken from the quads in the order they will be
+   turned into assembler, each one stretching from the first quad where the
+   symbol is live (or assigned) to the last, also across the jumps of
+   loops, which liveness analysis takes care of. Two symbols whose ranges
+   don't overlap can share a register or a slot.
+
+   Integer variables, parameters and temporaries go in the registers listed
+   in codegen.hh, by linear scan: going through the ranges in the order
+   they start, each one gets a register which is free by then. When none
+   is, the range least worth a register is left in memory, which is the
+   one whose symbol is read and written the fewest times, counting those
+   inside loops eight times per loop level. A parameter given a register is
+   fetched into it as the routine starts, but only if it is live then: one
+   which is assigned before it is read may have been given the register of
+   another parameter.
+
+   The temporaries left in memory share slots the same way. Such ranges
+   form an interval graph, and handing out the slots in the order the
+   ranges start, reusing a slot as soon as the range occupying it has
+   ended, gives as few slots as there are temporaries live at once.
+
+   A routine which calls nothing doesn't need a register window or a frame
+   of its own, if all its symbols fit in the few %o registers it may use
+   then (see leaf_registers in codegen.hh). Such a leaf routine is first
+   given registers from those, and if some symbol is left without one, it
+   is given registers the usual way instead. */
+
+
+/* Returns 1 if a symbol has a slot in the activation record of the routine
+   whose locals are at the given level. */
+static int has_frame_slot(sym_index sym_p, int level) {
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    return (tag == SYM_VAR || tag == SYM_ARRAY) &&
+	sym_tab->get_symbol(sym_p)->level == level &&
+	sym_tab->get_symbol(sym_p)->reg == NO_REGISTER;
+}
+
+
+static int frame_slot_size(sym_index sym_p) {
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    int size = sym_tab->get_size(sym->type);
+
+    if(sym->tag == SYM_ARRAY)
+	size *= sym->get_array_symbol()->array_cardinality;
+    return size;
+}
+
+
+/* Return the offset of the first place at or after next_offset where size
+   bytes don't overlap any of the fixed slots, and move next_offset past
+   it. */
+static int place_slot(int *next_offset, int size, int *fixed_start,
+		      int *fixed_end, int nr_fixed) {
+    for(int i = 0; i < nr_fixed; i++)
+	if(*next_offset < fixed_end[i] &&
+	   fixed_start[i] < *next_offset + size) {
+	    *next_offset = fixed_end[i];
+	    i = -1;
+	}
+    int offset = *next_offset;
+    *next_offset += size;
+    return offset;
+}
+
+
+/* Returns 1 if a routine may be made a leaf, as described above, if its
+   symbols get registers. It mustn't call anything, which includes the
+   routines in diesel_glue.s used for q_imult, q_idivide and q_imod
+   without the -m flag (and with it, division uses %o2 and %o3). Nor may
+   it use arrays or reals of its own, which live in memory, or symbols of
+   its own which nested routines use. The code generator has only %o0 and
+   %o1 to spare in a leaf, so relations whose value is stored (which use
+   %o2 and %o3) rule it out, and so do reals of enclosing routines and real
+   constants (which take %l0 to load), and variables of enclosing routines
+   too far from the frame pointer to be reached with an immediate
+   offset. */
+int quad_optimizer::may_be_leaf(quad_list *q_list, symbol *env,
+				bit_set *own_syms) {
+    sym_index syms[MAX_QUAD_SYMBOLS];
+    int level = env->level + 1;
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    int leaf = 1;
+
+    for(quadruple *q = ql_iterator->get_current(); q != NULL && leaf;
+	q = ql_iterator->get_next()) {
+	switch(q->op_code) {
+	case q_call:
+	case q_param:
+	case q_idivide:
+	case q_imod:
+	case q_ieq:
+	case q_ine:
+	case q_ilt:
+	case q_igt:
+	case q_ior:
+	case q_iand:
+	    leaf = 0;
+	    break;
+	case q_imult:
+	    leaf = sparc_v8;
+	    break;
+	default:
+	    break;
+	}
+	int nr_syms = q->get_symbols(syms);
+	for(int i = 0; i < nr_syms; i++) {
+	    if(syms[i] == NULL_SYM)
+		continue;
+	    symbol *sym = sym_tab->get_symbol(syms[i]);
+	    if(sym->type == real_type ||
+	       (sym->tag == SYM_ARRAY && sym->level == level) ||
+	       ((sym->tag == SYM_VAR || sym->tag == SYM_PARAM ||
+		 sym->tag == SYM_ARRAY) && sym->level < level &&
+		sym->offset + FIRST_ARG_OFFSET + frame_slot_size(syms[i]) >
+		4095))
+		leaf = 0;
+	}
+    }
+    delete ql_iterator;
+
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++)
+	if(own_syms->member(sym_p) &&
+	   sym_tab->get_symbol(sym_p)->level == level &&
+	   outer_refs->member(sym_p))
+	    leaf = 0;
+    return leaf;
+}
+
+
+/* Remember the variables and parameters of enclosing routines that a
+   routine uses. */
+void quad_optimizer::note_outer_references(quad_list *q_list, symbol *env) {
+    sym_index syms[MAX_QUAD_SYMBOLS];
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+
+    for(quadruple *q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next()) {
+	int nr_syms = q->get_outer_refs(env->level, syms);
+	for(int i = 0; i < nr_syms; i++)
+	    outer_refs->add(syms[i]);
+    }
+    delete ql_iterator;
+}
+
+
+/* Find the live ranges of the scalars of a routine which may be kept in a
+   register or share a slot, as described above. Each quad has two points:
+   2 * pos, where it reads its operands, and 2 * pos + 1, where it writes
+   its result. A range is stored as the first and last point where the
+   symbol is live, and the symbols are stored in syms, in the order their
+   ranges start. weight is the number of times each symbol is mentioned,
+   counting those inside loops more. The parameters are also marked with
+   whether they are live on entry. Returns the number of symbols. */
+int quad_optimizer::find_live_ranges(quad_list *q_list, symbol *env,
+				     sym_index *syms, int *first, int *last,
+				     int *weight) {
+    sym_index uses[MAX_QUAD_USES + 1];
+    flow_graph *graph = new flow_graph(q_list, env);
+    liveness *live = new liveness(graph);
+    char *found = new char[MAX_SYM];
+    int *depth = new int[graph->nr_blocks];
+    int nr_syms = 0;
+    int nr_quads = 0;
+    int nr_args = 0;
+    int pos = 0;
+    int i, j, t;
+
+    for(i = 0; i < graph->nr_blocks; i++)
+	nr_quads += graph->blocks[i]->nr_quads;
+    sym_index *args = new sym_index[nr_quads + 1];
+
+    for(i = 0; i < MAX_SYM; i++)
+	found[i] = 0;
+
+    // A jump back to an earlier block makes a loop of the blocks between.
+    for(i = 0; i < graph->nr_blocks; i++)
+	depth[i] = 0;
+    for(i = 0; i < graph->nr_blocks; i++)
+	for(j = 0; j < graph->blocks[i]->nr_succ; j++)
+	    for(t = graph->blocks[i]->succ[j]; t <= i; t++)
+		depth[t]++;
+
+    // The quads reading or writing each symbol stretch its range.
+    for(i = 0; i < graph->nr_blocks; i++) {
+	int loop_weight = 1;
+	for(t = 0; t < depth[i] && t < 3; t++)
+	    loop_weight *= 8;
+
+	for(j = 0; j < graph->blocks[i]->nr_quads; j++, pos++) {
+	    quadruple *q = graph->blocks[i]->quads[j];
+	    int nr_uses = q->get_uses(uses);
+	    int nr_mentioned = nr_uses;
+	    if(q->get_def() != NULL_SYM)
+		uses[nr_mentioned++] = q->get_def();
+
+	    for(int k = 0; k < nr_mentioned; k++) {
+		sym_index sym_p = uses[k];
+		int point = 2 * pos + (k < nr_uses ? 0 : 1);
+		if(sym_p == NULL_SYM || !is_scalar_symbol(sym_p) ||
+		   sym_tab->get_symbol(sym_p)->level != env->level + 1 ||
+		   outer_refs->member(sym_p))
+		    continue;
+		if(!found[sym_p]) {
+		    found[sym_p] = 1;
+		    syms[nr_syms++] = sym_p;
+		    first[sym_p] = point;
+		    last[sym_p] = point;
+		    weight[sym_p] = 0;
+		}
+		if(point < first[sym_p])
+		    first[sym_p] = point;
+		if(point > last[sym_p])
+		    last[sym_p] = point;
+		weight[sym_p] += loop_weight;
+	    }
+
+	    // The arguments are only fetched by the call they are given to
+	    // (see expand() in codegen.cc), so they have to stay where they
+	    // are until then, past the calls and jumps which may come in
+	    // between.
+	    if(q->op_code == q_param)
+		args[nr_args++] = q->sym1;
+	    else if(q->op_code == q_call)
+		for(t = 0; t < q->int2; t++) {
+		    sym_index sym_p = args[--nr_args];
+		    if(sym_p != NULL_SYM && found[sym_p] &&
+		       2 * pos > last[sym_p])
+			last[sym_p] = 2 * pos;
+		}
+	}
+    }
+
+    // And so does being live into or out of a block.
+    pos = 0;
+    for(i = 0; i < graph->nr_blocks; i++) {
+	int end = pos + graph->blocks[i]->nr_quads - 1;
+	for(t = 0; t < nr_syms; t++) {
+	    sym_index sym_p = syms[t];
+	    if(live->in[i]->member(sym_p) && 2 * pos < first[sym_p])
+		first[sym_p] = 2 * pos;
+	    if(live->out[i]->member(sym_p) && 2 * end + 1 > last[sym_p])
+		last[sym_p] = 2 * end + 1;
+	}
+	pos = end + 1;
+    }
+
+    // Only the parameters live as the routine starts are fetched into
+    // their registers (see prologue() in codegen.cc).
+    for(t = 0; t < nr_syms; t++)
+	if(sym_tab->get_symbol_tag(syms[t]) == SYM_PARAM)
+	    sym_tab->get_symbol(syms[t])->get_parameter_symbol()->
+		live_on_entry = live->in[0]->member(syms[t]);
+
+    // Sort the symbols after where their ranges start. They are mostly in
+    // order already.
+    for(i = 1; i < nr_syms; i++) {
+	sym_index sym_p = syms[i];
+	for(j = i; j > 0 && first[syms[j - 1]] > first[sym_p]; j--)
+	    syms[j] = syms[j - 1];
+	syms[j] = sym_p;
+    }
+
+    delete live;
+    delete graph;
+    delete[] found;
+    delete[] depth;
+    delete[] args;
+    return nr_syms;
+}
+
+
+/* Give the integer symbols registers by linear scan, as described above,
+   using the first nr_registers of the register table. A range may start
+   at the quad where another one ends, since the quad reads its operands
+   before it writes its result. */
+void quad_optimizer::allocate_registers(sym_index *syms, int nr_syms,
+					int *first, int *last, int *weight,
+					int nr_registers) {
+    sym_index active[NR_REGISTER_VARIABLES];
+    int nr_active = 0;
+    int r, a;
+
+    for(int i = 0; i < nr_syms; i++) {
+	sym_index sym_p = syms[i];
+	symbol *sym = sym_tab->get_symbol(sym_p);
+	if(sym->type != integer_type)
+	    continue;
+
+	// Free the registers of the ranges which have ended.
+	for(a = 0; a < nr_active; a++)
+	    if(last[active[a]] < first[sym_p])
+		active[a--] = active[--nr_active];
+
+	if(nr_active < nr_registers) {
+	    for(r = 0; r < nr_registers; r++) {
+		for(a = 0; a < nr_active; a++)
+		    if(sym_tab->get_symbol(active[a])->reg == r)
+			break;
+		if(a == nr_active)
+		    break;
+	    }
+	    sym->reg = r;
+	    active[nr_active++] = sym_p;
+	    continue;
+	}
+
+	// Take the register of the active range least worth one, if it is
+	// worth less than this one.
+	int least = 0;
+	for(a = 1; a < nr_active; a++)
+	    if(weight[active[a]] < weight[active[least]])
+		least = a;
+	if(weight[active[least]] < weight[sym_p]) {
+	    symbol *spilled = sym_tab->get_symbol(active[least]);
+	    sym->reg = spilled->reg;
+	    spilled->reg = NO_REGISTER;
+	    active[least] = sym_p;
+	}
+    }
+}
+
+
+/* Give the temporaries left in memory slot numbers, as described above.
+   The slot of each temporary is stored in slot, which is -1 for the other
+   symbols. Returns the number of slots. */
+int quad_optimizer::assign_temporary_slots(sym_index *syms, int nr_syms,
+					   int *first, int *last, int *slot) {
+    int *slot_end = new int[nr_syms + 1];
+    int nr_slots = 0;
+
+    for(int i = 0; i < nr_syms; i++) {
+	sym_index sym_p = syms[i];
+	if(!sym_tab->is_temp_var(sym_p) ||
+	   sym_tab->get_symbol(sym_p)->reg != NO_REGISTER)
+	    continue;
+	int k;
+	for(k = 0; k < nr_slots; k++)
+	    if(slot_end[k] < first[sym_p])
+		break;
+	if(k == nr_slots)
+	    nr_slots++;
+	slot[sym_p] = k;
+	slot_end[k] = last[sym_p];
+    }
+
+    delete[] slot_end;
+    return nr_slots;
+}
+
+
+/* Decide where the symbols of a routine are kept, as described above.
+   own_syms holds the symbols entered while the routine was parsed and
+   optimized, including those of the routines nested inside it, which the
+   level tells apart. Those of other routines aren't in it, since with the
+   -w flag the symbol table holds the rest of the program by now. */
+void quad_optimizer::allocate_storage(quad_list *q_list, symbol *env,
+				      bit_set *own_syms) {
+    sym_index syms[MAX_QUAD_SYMBOLS];
+    int level = env->level + 1;
+    bit_set *used = new bit_set(MAX_SYM);
+    sym_index *ranges = new sym_index[MAX_SYM];
+    int *first = new int[MAX_SYM];
+    int *last = new int[MAX_SYM];
+    int *weight = new int[MAX_SYM];
+    int *fixed_start = new int[MAX_SYM];
+    int *fixed_end = new int[MAX_SYM];
+    int *slot = new int[MAX_SYM];
+    int nr_fixed = 0;
+    int ar_size = 0;
+    sym_index sym_p;
+    int i;
+
+    if(env->tag != SYM_PROC && env->tag != SYM_FUNC)
+	fatal("quad_optimizer::allocate_storage() called for non-proc/func");
+
+    // This may not be the first time, if the routine has been optimized
+    // again (or is a clone of one, sharing its symbols).
+    for(sym_p = 0; sym_p < MAX_SYM; sym_p++) {
+	if(own_syms->member(sym_p))
+	    sym_tab->get_symbol(sym_p)->reg = NO_REGISTER;
+	slot[sym_p] = -1;
+    }
+
+    int nr_ranges = find_live_ranges(q_list, env, ranges, first, last,
+				     weight);
+    int leaf = may_be_leaf(q_list, env, own_syms);
+    if(leaf) {
+	allocate_registers(ranges, nr_ranges, first, last, weight,
+			   NR_LEAF_REGISTERS);
+	for(i = 0; i < nr_ranges; i++)
+	    if(sym_tab->get_symbol(ranges[i])->reg == NO_REGISTER)
+		leaf = 0;
+	if(!leaf)
+	    for(i = 0; i < nr_ranges; i++)
+		sym_tab->get_symbol(ranges[i])->reg = NO_REGISTER;
+    }
+    if(!leaf)
+	allocate_registers(ranges, nr_ranges, first, last, weight,
+			   NR_REGISTER_VARIABLES);
+    int nr_slots = assign_temporary_slots(ranges, nr_ranges, first, last,
+					  slot);
+    int *slot_offset = new int[nr_slots + 1];
+
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    for(quadruple *q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next()) {
+	int nr_syms = q->get_symbols(syms);
+	for(i = 0; i < nr_syms; i++)
+	    if(syms[i] != NULL_SYM)
+		used->add(syms[i]);
+    }
+    delete ql_iterator;
+
+    // The slots which have to stay.
+    for(sym_p = 0; sym_p < MAX_SYM; sym_p++)
+	if(own_syms->member(sym_p) && has_frame_slot(sym_p, level) &&
+	   outer_refs->member(sym_p)) {
+	    fixed_start[nr_fixed] = sym_tab->get_symbol(sym_p)->offset;
+	    fixed_end[nr_fixed] = fixed_start[nr_fixed] +
+		frame_slot_size(sym_p);
+	    if(fixed_end[nr_fixed] > ar_size)
+		ar_size = fixed_end[nr_fixed];
+	    nr_fixed++;
+	}
+
+    // The others go at the first place after the previous one where they
+    // don't overlap a slot which has to stay, the temporaries last.
+    int next_offset = 0;
+    for(sym_p = 0; sym_p < MAX_SYM; sym_p++) {
+	if(!own_syms->member(sym_p) || !has_frame_slot(sym_p, level) ||
+	   !used->member(sym_p) || outer_refs->member(sym_p) ||
+	   slot[sym_p] != -1)
+	    continue;
+	sym_tab->get_symbol(sym_p)->offset =
+	    place_slot(&next_offset, frame_slot_size(sym_p), fixed_start,
+		       fixed_end, nr_fixed);
+    }
+    for(i = 0; i < nr_slots; i++)
+	slot_offset[i] = place_slot(&next_offset, 4, fixed_start, fixed_end,
+				    nr_fixed);
+    for(sym_p = 0; sym_p < MAX_SYM; sym_p++)
+	if(slot[sym_p] != -1)
+	    sym_tab->get_symbol(sym_p)->offset = slot_offset[slot[sym_p]];
+    if(next_offset > ar_size)
+	ar_size = next_offset;
+    if(leaf && ar_size > 0)
+	fatal("quad_optimizer::allocate_storage(): leaf routine with a frame");
+
+    if(env->tag == SYM_PROC) {
+	env->get_procedure_symbol()->ar_size = ar_size;
+	env->get_procedure_symbol()->is_leaf = leaf;
+    } else {
+	env->get_function_symbol()->ar_size = ar_size;
+	env->get_function_symbol()->is_leaf = leaf;
+    }
+
+    delete used;
+    delete[] ranges;
+    delete[] first;
+    delete[] last;
+    delete[] weight;
+    delete[] fixed_start;
+    delete[] fixed_end;
+    delete[] slot;
+    delete[] slot_offset;
+}
+
+
+
+/**********************************
+ *** WHOLE PROGRAM OPTIMIZATION ***
+ **********************************/
+
+
+/* Normally each routine is optimized and turned into assembler as soon as
+   it has been parsed, before the routines calling it have been seen. With
+   the -w flag, parser.y hands the optimized routines to defer_routine()
+   instead, and when the whole program has been parsed optimize_program()
+   looks at all the calls to each routine:
+
+   If a parameter is given the same constant by every call, and nothing in
+   the program assigns it, it holds that constant all through the routine,
+   so its uses (also those in routines nested inside it) are replaced by
+   the constant.
+
+   If some calls inside loops give constant arguments, but others don't,
+   a copy of the routine is made for those calls, with the parameters
+   replaced by the constants.
+
+   The routines changed are then optimized again, to fold what the
+   constants make foldable. The routines are visited callers first (ie, in
+   the opposite order of how they were parsed), so the arguments of a call
+   are final by the time we look at the routine called, and constants can
+   travel down the call chain. */
+
+
+/* Return the quads of a list as an array, and their number in nr_quads. */
+static quadruple **quad_array(quad_list *q_list, int *nr_quads) {
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quadruple *q;
+
+    *nr_quads = 0;
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	(*nr_quads)++;
+    delete ql_iterator;
+
+    quadruple **quads = new quadruple *[*nr_quads + 1];
+    *nr_quads = 0;
+    ql_iterator = new quad_list_iterator(q_list);
+    for(q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next())
+	quads[(*nr_quads)++] = q;
+    delete ql_iterator;
+    return quads;
+}
+
+
+/* Returns 1 if the quad at position pos is inside a loop, ie, between a
+   label and a jump back to it. */
+static int is_in_loop(quadruple **quads, int nr_quads, int pos) {
+    for(int i = 0; i < pos; i++) {
+	if(quads[i]->op_code != q_labl)
+	    continue;
+	for(int j = pos + 1; j < nr_quads; j++)
+	    if((quads[j]->op_code == q_jmp || quads[j]->op_code == q_jmpf ||
+		quads[j]->op_code == q_jmpt) &&
+	       quads[j]->int1 == quads[i]->int1)
+		return 1;
+    }
+    return 0;
+}
+
+
+/* Returns 1 if two constant symbols have the same type and value. */
+static int same_constant(sym_index a, sym_index b) {
+    return sym_tab->get_symbol_type(a) == sym_tab->get_symbol_type(b) &&
+	sym_tab->get_symbol(a)->get_constant_symbol()->const_value.ival ==
+	sym_tab->get_symbol(b)->get_constant_symbol()->const_value.ival;
+}
+
+
+/* Return a new entry last in the routines. */
+program_routine *quad_optimizer::add_routine() {
+    if(nr_routines == max_routines) {
+	program_routine *new_routines = new program_routine[max_routines * 2];
+	for(int i = 0; i < nr_routines; i++)
+	    new_routines[i] = routines[i];
+	delete[] routines;
+	routines = new_routines;
+	max_routines *= 2;
+    }
+    return &routines[nr_routines++];
+}
+
+
+/* Save a routine whose assembler code is to be generated later. Its own
+   symbols are those entered after it so far, since the routines declared
+   after it haven't been parsed yet. The temporaries made for it when it
+   is optimized again are added to them by reoptimize(). */
+void quad_optimizer::defer_routine(quad_list *q_list, symbol *env) {
+    program_routine *r = add_routine();
+    r->env = env;
+    r->env_p = routine_index(env);
+    r->own_syms = new bit_set(MAX_SYM);
+    add_symbols_from(r->own_syms, r->env_p + 1);
+    r->quads = q_list;
+    r->params = find_formals(env, &r->nr_params);
+    r->nr_clones = 0;
+    r->changed = 0;
+}
+
+
+/* Returns 1 if a symbol is assigned anywhere in the program. */
+int quad_optimizer::is_assigned(sym_index sym_p) {
+    for(int i = 0; i < nr_routines; i++) {
+	quad_list_iterator *ql_iterator =
+	    new quad_list_iterator(routines[i].quads);
+	for(quadruple *q = ql_iterator->get_current(); q != NULL;
+	    q = ql_iterator->get_next())
+	    if(q->get_def() == sym_p) {
+		delete ql_iterator;
+		return 1;
+	    }
+	delete ql_iterator;
+    }
+    return 0;
+}
+
+
+/* Replace the uses of a symbol in a quad list by another symbol. Returns 1
+   if there were any. */
+static int replace_uses(quad_list *q_list, sym_index old_sym,
+			sym_index new_sym) {
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    sym_index uses[MAX_QUAD_USES];
+    int replaced = 0;
+
+    for(quadruple *q = ql_iterator->get_current(); q != NULL;
+	q = ql_iterator->get_next()) {
+	int nr_uses = q->get_uses(uses);
+	for(int i = 0; i < nr_uses; i++)
+	    if(uses[i] == old_sym) {
+		q->replace_use(old_sym, new_sym);
+		replaced = 1;
+		break;
+	    }
+    }
+    delete ql_iterator;
+    return replaced;
+}
+
+
+/* Find the constant each parameter of a routine is given by all calls to
+   it, and replace the parameters which are never assigned by them. */
+void quad_optimizer::propagate_arguments(program_routine *r) {
+    if(r->nr_params == 0)
+	return;
+
+    char *lattice = new char[r->nr_params];
+    sym_index *value = new sym_index[r->nr_params];
+    int *params = new int[r->nr_params];
+    int i, j, k;
+
+    for(j = 0; j < r->nr_params; j++)
+	lattice[j] = LATTICE_TOP;
+
+    for(i = 0; i < nr_routines; i++) {
+	int nr_quads;
+	quadruple **quads = quad_array(routines[i].quads, &nr_quads);
+	for(k = 0; k < nr_quads; k++) {
+	    if(quads[k]->op_code != q_call || quads[k]->sym1 != r->env_p)
+		continue;
+	    if(!find_params(quads, k, params)) {
+		for(j = 0; j < r->nr_params; j++)
+		    lattice[j] = LATTICE_BOTTOM;
+		continue;
+	    }
+	    for(j = 0; j < r->nr_params; j++) {
+		sym_index arg = quads[params[j]]->sym1;
+		if(sym_tab->get_symbol_tag(arg) != SYM_CONST)
+		    lattice[j] = LATTICE_BOTTOM;
+		else if(lattice[j] == LATTICE_TOP) {
+		    lattice[j] = LATTICE_CONST;
+		    value[j] = arg;
+		} else if(lattice[j] == LATTICE_CONST &&
+			  !same_constant(value[j], arg))
+		    lattice[j] = LATTICE_BOTTOM;
+	    }
+	}
+	delete[] quads;
+    }
+
+    for(j = 0; j < r->nr_params; j++) {
+	if(lattice[j] != LATTICE_CONST || is_assigned(r->params[j]))
+	    continue;
+	for(i = 0; i < nr_routines; i++)
+	    if(replace_uses(routines[i].quads, r->params[j], value[j]))
+		routines[i].changed = 1;
+    }
+
+    delete[] lattice;
+    delete[] value;
+    delete[] params;
+}
+
+
+/* Make a copy of a routine, with new labels and with the parameters given
+   a constant in args (NULL_SYM for the others) replaced by it. The copy is
+   optimized, and added to the routines. Returns its symbol. The routines
+   nested inside the original are not copied, and are called by the copy
+   as they are, so they reach its frame through the display just like the
+   original's. The copy's symbol says it has to set the display register
+   whenever the original's does (see gen_clone() in symtab.cc), and the
+   parameters and variables they use keep their slots (see
+   allocate_storage()). */
+sym_index quad_optimizer::clone_routine(program_routine *r, sym_index *args) {
+    int nr_quads;
+    quadruple **quads = quad_array(r->quads, &nr_quads);
+    int *old_labels = new int[nr_quads + 1];
+    int *new_labels = new int[nr_quads + 1];
+    int nr_labels = 0;
+    int i, j;
+
+    old_labels[nr_labels] = r->quads->last_label;
+    new_labels[nr_labels++] = sym_tab->get_next_label();
+    quad_list *q_list = new quad_list(new_labels[0]);
+
+    for(i = 0; i < nr_quads; i++) {
+	quadruple *q = new quadruple(*quads[i]);
+	switch(q->op_code) {
+	case q_labl:
+	case q_jmp:
+	case q_jmpf:
+	case q_jmpt:
+	case q_rreturn:
+	case q_ireturn:
+	    for(j = 0; j < nr_labels; j++)
+		if(old_labels[j] == q->int1)
+		    break;
+	    if(j == nr_labels) {
+		old_labels[j] = q->int1;
+		new_labels[j] = sym_tab->get_next_label();
+		nr_labels++;
+	    }
+	    q->int1 = new_labels[j];
+	    break;
+	default:
+	    break;
+	}
+	*q_list += q;
+    }
+    for(j = 0; j < r->nr_params; j++)
+	if(args[j] != NULL_SYM)
+	    replace_uses(q_list, r->params[j], args[j]);
+
+    // Adding to the routines may move them, so r can't be used after this.
+    sym_index clone_p = sym_tab->gen_clone(r->env_p);
+    sym_index *params = r->params;
+    int nr_params = r->nr_params;
+    bit_set *own_syms = new bit_set(MAX_SYM);
+    own_syms->copy(r->own_syms);
+    program_routine *clone = add_routine();
+    clone->env = sym_tab->get_symbol(clone_p);
+    clone->env_p = clone_p;
+    clone->own_syms = own_syms;
+    clone->quads = q_list;
+    clone->params = params;
+    clone->nr_params = nr_params;
+    clone->nr_clones = MAX_CLONES;
+    reoptimize(clone);
+
+    delete[] quads;
+    delete[] old_labels;
+    delete[] new_labels;
+    return clone_p;
+}
+
+
+/* Make specialized copies of a routine for the calls inside loops which
+   give some of its parameters a constant. Calls giving the same constants
+   share a copy. Only parameters which are never assigned, and which are
+   still used (ie, weren't replaced by propagate_arguments()), count. */
+void quad_optimizer::specialize(int routine_nr) {
+    program_routine *r = &routines[routine_nr];
+    if(r->nr_params == 0)
+	return;
+
+    int nr_quads;
+    quadruple **quads = quad_array(r->quads, &nr_quads);
+    int size = 0;
+    char *useful = new char[r->nr_params];
+    int i, j, k;
+
+    for(i = 0; i < nr_quads; i++)
+	if(quads[i]->op_code != q_labl)
+	    size++;
+    int nr_useful = 0;
+    for(j = 0; j < r->nr_params; j++) {
+	useful[j] = 0;
+	for(i = 0; i < nr_quads && !useful[j]; i++) {
+	    sym_index uses[MAX_QUAD_USES];
+	    int nr_uses = quads[i]->get_uses(uses);
+	    for(k = 0; k < nr_uses; k++)
+		if(uses[k] == r->params[j])
+		    useful[j] = 1;
+	}
+	if(useful[j] && is_assigned(r->params[j]))
+	    useful[j] = 0;
+	nr_useful += useful[j];
+    }
+    delete[] quads;
+    if(nr_useful == 0 || size > MAX_CLONED_QUADS) {
+	delete[] useful;
+	return;
+    }
+
+    int nr_params = r->nr_params;
+    sym_index env_p = r->env_p;
+    sym_index *clones = new sym_index[MAX_CLONES];
+    sym_index *clone_args = new sym_index[MAX_CLONES * nr_params];
+    int nr_clones = 0;
+    sym_index *args = new sym_index[nr_params];
+    int *params = new int[nr_params];
+
+    // The clones are added last, so the routines looked at here stay put,
+    // even if the array holding them is moved.
+    int nr_callers = nr_routines;
+    for(i = 0; i < nr_callers; i++) {
+	quadruple **calls = quad_array(routines[i].quads, &nr_quads);
+	for(k = 0; k < nr_quads; k++) {
+	    if(calls[k]->op_code != q_call || calls[k]->sym1 != env_p ||
+	       !is_in_loop(calls, nr_quads, k) || !find_params(calls, k, params))
+		continue;
+	    int nr_const = 0;
+	    for(j = 0; j < nr_params; j++) {
+		args[j] = calls[params[j]]->sym1;
+		if(!useful[j] || sym_tab->get_symbol_tag(args[j]) != SYM_CONST)
+		    args[j] = NULL_SYM;
+		else
+		    nr_const++;
+	    }
+	    if(nr_const == 0)
+		continue;
+
+	    int c;
+	    for(c = 0; c < nr_clones; c++) {
+		for(j = 0; j < nr_params; j++) {
+		    sym_index a = clone_args[c * nr_params + j];
+		    if((a == NULL_SYM) != (args[j] == NULL_SYM) ||
+		       (a != NULL_SYM && !same_constant(a, args[j])))
+			break;
+		}
+		if(j == nr_params)
+		    break;
+	    }
+	    if(c == nr_clones) {
+		if(routines[routine_nr].nr_clones == MAX_CLONES)
+		    continue;
+		routines[routine_nr].nr_clones++;
+		for(j = 0; j < nr_params; j++)
+		    clone_args[c * nr_params + j] = args[j];
+		clones[c] = clone_routine(&routines[routine_nr], args);
+		nr_clones++;
+	    }
+	    calls[k]->sym1 = clones[c];
+	}
+	delete[] calls;
+    }
+
+    delete[] useful;
+    delete[] clones;
+    delete[] clone_args;
+    delete[] args;
+    delete[] params;
+}
+
+
+/* Optimize a routine again, in its own scope. */
+void quad_optimizer::reoptimize(program_routine *r) {
+    sym_index first_new = next_symbol_index();
+    block_level level = sym_tab->reopen_scope(r->env_p);
+    cfg = new flow_graph(r->quads, r->env);
+    optimize_scalars();
+    r->quads = cfg->linearize();
+    delete cfg;
+    cfg = NULL;
+    sym_tab->leave_scope(level);
+    add_symbols_from(r->own_syms, first_new);
+    r->changed = 0;
+}
+
+
+/* Optimize the deferred routines using what the calls between them tell
+   us. See the start of this section. */
+void quad_optimizer::optimize_program() {
+    int i;
+
+    for(i = nr_routines - 1; i >= 0; i--) {
+	propagate_arguments(&routines[i]);
+	specialize(i);
+	if(routines[i].changed)
+	    reoptimize(&routines[i]);
+    }
+    for(i = 0; i < nr_routines; i++)
+	if(routines[i].changed)
+	    reoptimize(&routines[i]);
+}
+
+
+/* Return the number of deferred routines, including the specialized
+   copies. */
+int quad_optimizer::nr_deferred() {
+    return nr_routines;
+}
+
+
+/* Return the quads of a deferred routine, and its symbol in env. */
+quad_list *quad_optimizer::get_deferred(int i, symbol **env) {
+    // A clone shares its symbols with the routine it was made from, so
+    // where they are kept is decided just before the code is generated.
+    // See allocate_storage().
+    routines[i].quads = fuse_conditional_jumps(routines[i].quads);
+    allocate_storage(routines[i].quads, routines[i].env,
+		     routines[i].own_syms);
+    *env = routines[i].env;
+    return routines[i].quads;
+}
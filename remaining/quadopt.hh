@@ -0,0 +1,260 @@
+#ifndef __QUADOPT_HH__
+#define __QUADOPT_HH__
+
+#include "symtab.hh"
+#include "quads.hh"
+#include "flowgraph.hh"
+#include "ssa.hh"
+
+
+/*** This class performs optimization on the quad list of a procedure,
+     function or the main program, after it has been generated from the AST
+     but before the code generator sees it. The AST optimizer in optimize.cc
+     can only fold expressions that are constant in the source; here we work
+     on the flow graph of the routine (see flowgraph.hh), where the
+     temporaries created by quads.cc make repeated work visible.
+
+     Currently the following is done:
+       Tail recursion elimination, ie, a call a routine makes to itself just
+       before returning becomes a jump back to its start.
+       Inlining, ie, calls to small procedures and functions compiled
+       earlier are replaced by a copy of their optimized quads (see the -i
+       flag in main.cc).
+       Local value numbering, ie, within each basic block, a computation
+       which has already been done (and whose operands haven't changed since)
+       is replaced by the temporary holding the earlier result. This
+       includes calls to pure functions.
+       Copy propagation, ie, temporaries which are only copies of constants
+       or other temporaries are replaced by what they copy, and a result
+       which is computed into a temporary only to be copied to a variable is
+       computed directly into the variable.
+       Dead code elimination, ie, quads computing temporaries which are
+       never read are removed.
+       Then the routine is converted to SSA form (see ssa.hh), where the
+       following is done before it is converted back:
+       Sparse conditional constant propagation, ie, integer variables and
+       temporaries which are known to hold a constant are replaced by the
+       constant, and conditional jumps which are known to go one way are
+       replaced by an unconditional jump, or removed.
+       Dead code elimination again, now also for the routine's own
+       variables.
+       Calls only make the analyses forget about the variables and arrays
+       the callee may read or write, as told by the effect summaries the
+       type checker computes (see symtab.hh).
+       Finally, each loop is optimized, inner loops first:
+       Loop invariant code motion, ie, computations inside a loop whose
+       operands don't change in the loop are moved to a preheader block
+       before it, and so are reads of variables declared outside the
+       routine which the loop doesn't change.
+       Strength reduction, ie, array elements indexed by an induction
+       variable (one stepped by the same amount every time round) are
+       reached through a pointer which is stepped along with it, and
+       variables only used to end the loop are replaced by the pointer.
+       Loop unrolling, ie, the body of a loop which is known to run a
+       constant number of times is repeated a few times (see the -u flag in
+       main.cc), so that the test ending it is done less often.
+       Dead store elimination, ie, assignments to variables whose values
+       are never read are removed, using liveness analysis.
+       A relation only used by the conditional jump after it is made
+       part of the jump, so it becomes a compare and branch.
+       Last, integer variables and temporaries are given registers by
+       linear scan register allocation, and the activation record is laid
+       out again with room only for the variables and temporaries the quads
+       still use and which didn't get a register. Temporaries which are
+       never live at the same time share a slot. A routine which calls
+       nothing, and whose symbols fit in a few %o registers, is made a
+       leaf, which runs without a register window or frame of its own.
+       With the -w flag, the routines are optimized again once the whole
+       program has been parsed, with parameters replaced by the constants
+       the calls give them (see the end of quadopt.cc). ***/
+
+
+class quad_optimizer;
+class value_entry;
+class ssa_use;
+class induction_variable;
+class derived_pointer;
+class inline_body;
+class program_routine;
+class bit_set;           // See dataflow.hh.
+class liveness;
+
+
+extern quad_optimizer *quad_opt; // Defined in quadopt.cc.
+
+
+class quad_optimizer {
+private:
+    flow_graph *cfg;             // The routine we're currently optimizing.
+    ssa_form   *ssa;             // Its SSA form, while we're in it.
+
+    int        *def_count;       // Nr of quads assigning each symbol.
+    int        *use_count;       // Nr of quads reading each symbol.
+    int        *use_block;       // The block all reads of a symbol are in,
+                                 // -1 if none and -2 if several.
+
+    // Used by inlining. See quadopt.cc.
+    inline_body *inline_bodies;  // The routines which may be inlined.
+    int         nr_inline;
+    int         max_inline;
+
+    void        save_for_inlining(quad_list *, symbol *);
+    inline_body *find_inline_body(sym_index);
+    void        expand_call(quad_list *, quadruple *, sym_index *,
+			    inline_body *);
+    quad_list  *inline_calls(quad_list *);
+
+    // Turn self calls in tail position into jumps. See quadopt.cc.
+    quad_list  *eliminate_tail_recursion(quad_list *, symbol *);
+
+    // Used by whole program optimization (the -w flag). See quadopt.cc.
+    program_routine *routines;   // The routines parsed so far.
+    int         nr_routines;
+    int         max_routines;
+
+    program_routine *add_routine();
+    int         is_assigned(sym_index);
+    void        propagate_arguments(program_routine *);
+    sym_index   clone_routine(program_routine *, sym_index *);
+    void        specialize(int);
+    void        reoptimize(program_routine *);
+
+    // Run the passes which don't work on loops.
+    void        optimize_scalars();
+
+    // Count defs and uses of all symbols in the current routine.
+    void        count_symbols();
+
+    // Returns 1 if the symbol always holds the same value in the routine,
+    // ie, it is a constant or a temporary with only one definition.
+    int         is_stable(sym_index);
+
+    // Tables used by local value numbering. See quadopt.cc.
+    int        *value_nr;        // Current value number of each symbol.
+    sym_index  *renamed;         // Removed temporary -> symbol to read.
+    int        *array_version;   // Version of the contents of each array.
+    char       *is_touched;      // 1 if the symbol is in touched.
+    sym_index  *touched;         // The symbols used in the current block.
+    int         nr_touched;
+
+    value_entry *values;         // The value table.
+    int         nr_values;
+    int         max_values;
+    int         last_value_nr;   // Last value number handed out.
+
+    void        touch(sym_index);
+    int         find_value(quad_op_type, long, long, int);
+    int         add_value(quad_op_type, long, long, int, sym_index, int);
+    int         find_entry(int);
+    int         value_of(sym_index);
+
+    // Used by copy propagation.
+    sym_index  *forwarded;       // Removed temporary -> symbol to read.
+    sym_index  *constants;       // The temporary constants created so far.
+    int         nr_constants;
+    int         max_constants;
+
+    // Return a constant symbol with a given type and value.
+    sym_index   constant_for(sym_index, int);
+
+    // Used by sparse conditional constant propagation. See quadopt.cc.
+    char       *lattice;         // Lattice value of each symbol.
+    int        *lattice_value;   // The constant, if lattice says so.
+    int        *first_use;       // Symbol -> first entry in ssa_uses.
+    ssa_use    *ssa_uses;        // The reads of all symbols.
+    int         nr_ssa_uses;
+    int         max_ssa_uses;
+    sym_index  *sym_work;        // Symbols whose lattice value has changed.
+    int         nr_sym_work;
+    char       *in_sym_work;
+    int        *flow_work;       // Blocks reached by a new edge.
+    int         nr_flow_work;
+    char       *block_done;      // 1 if a block's quads have been visited.
+    char       *edge_done;       // 1 if an edge can be taken.
+
+    void        add_ssa_use(sym_index, basic_block *, quadruple *,
+			    phi_node *);
+    char        lattice_of(sym_index, int *);
+    void        lower(sym_index, char, int);
+    void        mark_edge(basic_block *, int);
+    int         edge_taken(basic_block *, basic_block *);
+    void        visit_phi(basic_block *, phi_node *);
+    void        visit_quad(basic_block *, quadruple *);
+
+    // The optimization passes. They return 1 if they changed something.
+    int         local_value_numbering(basic_block *);
+    int         copy_propagation();
+    int         dead_code_elimination();
+    int         constant_propagation();
+    int         loop_optimization();
+    int         dead_store_elimination();
+
+    // Used by the loop optimizations. See quadopt.cc.
+    basic_block **loop_blocks;   // The blocks of the current loop.
+    int         nr_loop_blocks;
+    basic_block *preheader;      // The preheader of the current loop.
+    bit_set    *assigned;        // The symbols the loop may change.
+    sym_index  *callees;         // The routines called in the loop.
+    int         nr_callees;
+    induction_variable *ivs;     // The basic induction variables.
+    int         nr_ivs;
+    derived_pointer *pointers;   // The pointers derived from them.
+    int         nr_pointers;
+
+    int         optimize_loop(natural_loop *);
+    int         is_invariant(sym_index);
+    int         in_loop(basic_block *);
+    int         hoist_invariants(bit_set *);
+    void        find_induction_variables();
+    int         find_induction_variable(sym_index);
+    int         find_pointer(sym_index, int, quad_op_type, sym_index);
+    sym_index   pointer_step(int);
+    int         is_removable(int, liveness *);
+    void        replace_exit_test(int);
+    int         reduce_strength();
+    int         value_before(basic_block *, int, sym_index, sym_index *,
+			     int *);
+    int         unroll_loop();
+
+    // Turn relations tested by a jump into conditional jumps.
+    quad_list  *fuse_conditional_jumps(quad_list *);
+
+    // Used to lay out activation records and allocate registers. See
+    // quadopt.cc.
+    bit_set    *outer_refs;      // Variables used by nested routines.
+
+    void        note_outer_references(quad_list *, symbol *);
+    int         may_be_leaf(quad_list *, symbol *, bit_set *);
+    int         find_live_ranges(quad_list *, symbol *, sym_index *, int *,
+				 int *, int *);
+    void        allocate_registers(sym_index *, int, int *, int *, int *,
+				       int);
+    int         assign_temporary_slots(sym_index *, int, int *, int *,
+				       int *);
+    void        allocate_storage(quad_list *, symbol *, bit_set *);
+
+    // Print the dataflow sets of the routine, and its SSA form (the -l
+    // flag). Reaching definitions and available expressions are only
+    // computed for this; the passes themselves just use liveness.
+    void        print_dataflow_sets();
+    void        print_ssa_form();
+
+public:
+    quad_optimizer();
+
+    // This is the interface to parser.y. The argument is the quad list of
+    // a routine, and the symbol of that routine. Returns the optimized list.
+    quad_list  *do_optimize(quad_list *, symbol *);
+
+    // The interface to parser.y for whole program optimization. Instead of
+    // generating assembler for an optimized routine, parser.y defers it.
+    // When the whole program has been parsed, optimize_program() is
+    // called, after which the routines are fetched with get_deferred().
+    void        defer_routine(quad_list *, symbol *);
+    void        optimize_program();
+    int         nr_deferred();
+    quad_list  *get_deferred(int, symbol **);
+};
+
+
+#endif
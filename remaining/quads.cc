@@ -242,14 +242,38 @@ sym_index ast_mod::generate_quads(quad_list &q) {
     return generate_quads_binop(q, q_imod, this);
 }
 
+
+/* AND and OR are evaluated left to right, and the right operand only if
+   the left one doesn't decide the result: in "a and b", b isn't evaluated
+   if a is false, and in "a or b", not if a is true. This matters when b
+   calls a function which writes something or changes a variable, or
+   would divide by zero. See testpgm/shortcircuit.d.
+
+   So they are turned into jumps, by the generate_jump() methods below.
+   When the value is wanted (b := x < y and y < z), it is made by jumps to
+   code setting a temporary to 1 or 0. */
+static sym_index generate_quads_logical(quad_list& q, ast_expression* expr) {
+    sym_index sym_p = sym_tab->gen_temp_var(integer_type);
+    int label_false = sym_tab->get_next_label();
+    int label_end = sym_tab->get_next_label();
+
+    expr->generate_jump(q, label_false, 0);
+    q += new quadruple(q_iload, 1, NULL_SYM, sym_p);
+    q += new quadruple(q_jmp, label_end, NULL_SYM, NULL_SYM);
+    q += new quadruple(q_labl, label_false, NULL_SYM, NULL_SYM);
+    q += new quadruple(q_iload, 0, NULL_SYM, sym_p);
+    q += new quadruple(q_labl, label_end, NULL_SYM, NULL_SYM);
+    return sym_p;
+}
+
 sym_index ast_or::generate_quads(quad_list &q) {
     /* Your code here. */
-    return generate_quads_binop(q, q_ior, this);
+    return generate_quads_logical(q, this);
 }
 				   
 sym_index ast_and::generate_quads(quad_list &q) {
     /* Your code here. */
-    return generate_quads_binop(q, q_iand, this);
+    return generate_quads_logical(q, this);
 }
 
 
@@ -284,6 +308,52 @@ sym_index ast_greaterthan::generate_quads(quad_list &q) {
 
 
 
+/* Conditions. An expression tested by an if or a while jumps straight to
+   where it should go, instead of computing a truth value which is then
+   tested by q_jmpf or q_jmpt. For most expressions, that's what it comes
+   to anyway (the quad optimizer makes a single jump of a relation and the
+   q_jmpf testing it). NOT just swaps the targets, and AND and OR jump as
+   soon as the left operand decides the outcome, as described above. */
+void ast_expression::generate_jump(quad_list &q, int label, int if_true) {
+    sym_index val_p = generate_quads(q);
+    q += new quadruple((if_true ? q_jmpt : q_jmpf), label, val_p, NULL_SYM);
+}
+
+
+void ast_not::generate_jump(quad_list &q, int label, int if_true) {
+    expr->generate_jump(q, label, !if_true);
+}
+
+
+/* "a or b" is true if a is, and otherwise if b is. */
+void ast_or::generate_jump(quad_list &q, int label, int if_true) {
+    if(if_true) {
+	left->generate_jump(q, label, 1);
+	right->generate_jump(q, label, 1);
+    } else {
+	int label_true = sym_tab->get_next_label();
+	left->generate_jump(q, label_true, 1);
+	right->generate_jump(q, label, 0);
+	q += new quadruple(q_labl, label_true, NULL_SYM, NULL_SYM);
+    }
+}
+
+
+/* "a and b" is false if a is, and otherwise if b is. */
+void ast_and::generate_jump(quad_list &q, int label, int if_true) {
+    if(if_true) {
+	int label_false = sym_tab->get_next_label();
+	left->generate_jump(q, label_false, 0);
+	right->generate_jump(q, label, 1);
+	q += new quadruple(q_labl, label_false, NULL_SYM, NULL_SYM);
+    } else {
+	left->generate_jump(q, label, 0);
+	right->generate_jump(q, label, 0);
+    }
+}
+
+
+
 /* Since an lvalue can be either an id or an array reference, we can't solve
    this the usual way since there's no instanceof operator in C++ to find out
    which class an object belongs to. So we define the method
@@ -372,32 +442,39 @@ sym_index ast_functioncall::generate_quads(quad_list &q) {
 }
 
 
-/* Generate quads for a while statement. 
-   You get this one for free. */
+/* Generate quads for a while statement. The loop is rotated, ie, the
+   condition is tested at the bottom of the loop, so each turn of the loop
+   only runs one (conditional) jump instead of two:
+
+	    <condition>                  (the guard)
+	    q_jmpf   bottom
+	top:
+	    <body>
+	    <condition>
+	    q_jmpt   top
+	bottom:
+
+   The cost is that the quads for the condition are generated twice. */
 sym_index ast_while::generate_quads(quad_list &q) {
     int top, bottom;
-    sym_index pos;
 
     // We get two labels for jumps.
     top = sym_tab->get_next_label();
     bottom = sym_tab->get_next_label();
 
+    // Generate quads for the condition, jumping to the 'bottom' label if it
+    // is false, so that the loop isn't run at all.
+    condition->generate_jump(q, bottom, 0);
+
     // Here's the label for the top of the while body.
     q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
 
-    // Generate quads for the condition. After this code is being run, we
-    // check if the result in the variable stored in 'pos' is 0. If it is,
-    // we want to exit the loop, which is done via a conditional jump to the
-    // 'bottom' label.
-    pos = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, bottom, pos, NULL_SYM);
-
-    // Generate quads for the body. Following these come an unconditional
-    // jump to the 'top' label, ie, run the condition etc again.
-    pos = body->generate_quads(q);
-    q += new quadruple(q_jmp, top,  NULL_SYM, NULL_SYM);
+    // Generate quads for the body. Following these comes the condition
+    // again, and a jump back to the 'top' label if it is still true.
+    body->generate_quads(q);
+    condition->generate_jump(q, top, 1);
 
-    // This is where we jump to if the while condition evaluates to false.
+    // This is where we end up when the while condition evaluates to false.
     q += new quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
 
     return NULL_SYM;
@@ -410,8 +487,7 @@ void ast_elsif::generate_quads_and_jump(quad_list& q, int label_end) {
     /* Your code here. */
     int label_after = sym_tab->get_next_label();
 
-    sym_index cond_p = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, label_after, cond_p, NULL_SYM);
+    condition->generate_jump(q, label_after, 0);
 
     if(body != NULL)
 	body->generate_quads(q);
@@ -441,8 +517,7 @@ sym_index ast_if::generate_quads(quad_list &q) {
     else
       label_end = label_after;
 
-    sym_index cond_p = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, label_after, cond_p, NULL_SYM);
+    condition->generate_jump(q, label_after, 0);
 
     if(body != NULL)
 	body->generate_quads(q);
@@ -518,6 +593,27 @@ sym_index ast_functionhead::generate_quads(quad_list& q) {
 
 
 
+/* Note the variables of enclosing routines that a routine uses. It reaches
+   them through the display, so the routines they belong to have to set
+   their display registers (see prologue() in codegen.cc). This is decided
+   from the quads the routine starts out with, rather than when the code is
+   generated, since with the -w flag the routines are not turned into
+   assembler in the order they are parsed (see quadopt.cc). The optimizer
+   may remove some of these uses, but never adds others. */
+static void note_display_uses(quad_list *q, symbol *env) {
+    quad_list_iterator *ql_iterator = new quad_list_iterator(q);
+    sym_index syms[MAX_QUAD_SYMBOLS];
+
+    for(quadruple *quad = ql_iterator->get_current(); quad != NULL;
+	quad = ql_iterator->get_next()) {
+	int nr_syms = quad->get_outer_refs(env->level, syms);
+	for(int i = 0; i < nr_syms; i++)
+	    sym_tab->note_display_use(syms[i]);
+    }
+    delete ql_iterator;
+}
+
+
 /* These two methods actually start off the quad generation, also taking
    care of adding a last_label. The code is identical for the two methods. */
 quad_list *ast_procedurehead::do_quads(ast_stmt_list *s) {
@@ -528,6 +624,7 @@ quad_list *ast_procedurehead::do_quads(ast_stmt_list *s) {
 	s->generate_quads(*q);
 
     (*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+    note_display_uses(q, sym_tab->get_symbol(sym_p));
 
     return q;
 }
@@ -540,11 +637,202 @@ quad_list *ast_functionhead::do_quads(ast_stmt_list *s) {
 	s->generate_quads(*q);
 
     (*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+    note_display_uses(q, sym_tab->get_symbol(sym_p));
 
     return q;
 }
 
     
+/*****************************************
+ *** METHODS USED BY THE QUAD OPTIMIZER ***
+ *****************************************/
+
+
+/* Return the symbol a quad assigns a value to, or NULL_SYM if it doesn't
+   assign anything. Note that the stores don't count: they write to the
+   address held in sym3, not to sym3 itself. */
+sym_index quadruple::get_def() {
+    switch(op_code) {
+    case q_rload:
+    case q_iload:
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_rassign:
+    case q_iassign:
+    case q_call:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_rfetch:
+    case q_ifetch:
+    case q_itor:
+	return sym3;
+    default:
+	return NULL_SYM;
+    }
+}
+
+
+/* Fill in the symbols whose values a quad reads. The array symbol of the
+   indexing quads and the called symbol of q_call are not values, so they
+   are not included. Returns the number of symbols found. */
+int quadruple::get_uses(sym_index *uses) {
+    switch(op_code) {
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rassign:
+    case q_iassign:
+    case q_itor:
+    case q_rfetch:
+    case q_ifetch:
+    case q_param:
+	uses[0] = sym1;
+	return 1;
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_jieq:
+    case q_jine:
+    case q_jilt:
+    case q_jige:
+    case q_jigt:
+    case q_jile:
+    case q_jreq:
+    case q_jrne:
+    case q_jrlt:
+    case q_jrge:
+    case q_jrgt:
+    case q_jrle:
+	uses[0] = sym1;
+	uses[1] = sym2;
+	return 2;
+    case q_rstore:
+    case q_istore:
+	uses[0] = sym1;
+	uses[1] = sym3;
+	return 2;
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmpf:
+    case q_jmpt:
+	uses[0] = sym2;
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+
+/* Fill in the symbols a quad mentions: the ones it reads and writes, and
+   the array of the indexing quads. Returns the number of symbols found. */
+int quadruple::get_symbols(sym_index *syms) {
+    int nr_syms = get_uses(syms);
+
+    if(get_def() != NULL_SYM)
+	syms[nr_syms++] = get_def();
+    if(op_code == q_lindex || op_code == q_rrindex || op_code == q_irindex)
+	syms[nr_syms++] = sym1;
+    return nr_syms;
+}
+
+
+/* Fill in the variables, parameters and arrays a quad mentions which
+   belong to the routine at the given level or to one enclosing it. For
+   the quads of a routine, pass the level of the routine symbol itself:
+   these are then the symbols it reaches through the display. Returns the
+   number of symbols found. */
+int quadruple::get_outer_refs(int level, sym_index *syms) {
+    sym_index mentioned[MAX_QUAD_SYMBOLS];
+    int nr_mentioned = get_symbols(mentioned);
+    int nr_syms = 0;
+
+    for(int i = 0; i < nr_mentioned; i++) {
+	sym_type tag = sym_tab->get_symbol_tag(mentioned[i]);
+	if((tag == SYM_VAR || tag == SYM_PARAM || tag == SYM_ARRAY) &&
+	   sym_tab->get_symbol(mentioned[i])->level <= level)
+	    syms[nr_syms++] = mentioned[i];
+    }
+    return nr_syms;
+}
+
+
+/* Replace every read of one symbol with a read of another. The fields
+   replaced are exactly the ones get_uses() reports. */
+void quadruple::replace_use(sym_index old_sym, sym_index new_sym) {
+    sym_index uses[MAX_QUAD_USES];
+    int nr_uses = get_uses(uses);
+
+    if(nr_uses == 0)
+	return;
+
+    switch(op_code) {
+    case q_rstore:
+    case q_istore:
+	if(sym1 == old_sym)
+	    sym1 = new_sym;
+	if(sym3 == old_sym)
+	    sym3 = new_sym;
+	break;
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmpf:
+    case q_jmpt:
+	if(sym2 == old_sym)
+	    sym2 = new_sym;
+	break;
+    default:
+	if(sym1 == old_sym)
+	    sym1 = new_sym;
+	if(nr_uses == 2 && sym2 == old_sym)
+	    sym2 = new_sym;
+	break;
+    }
+}
+
+    
 /**********************************
  *** METHODS FOR PRINTING QUADS ***
  **********************************/
@@ -758,6 +1046,18 @@ void quadruple::print(ostream& o) {
 	      << setw(11) << sym_tab->get_symbol(sym2)
 	      << setw(11) << sym_tab->get_symbol(sym3);
 	    break;
+	case q_rfetch:
+	    o << setw(11) << "q_rfetch"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << "-"
+	      << setw(11) << sym_tab->get_symbol(sym3);
+	    break;
+	case q_ifetch:
+	    o << setw(11) << "q_ifetch"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << "-"
+	      << setw(11) << sym_tab->get_symbol(sym3);
+	    break;
 	case q_itor:
 	    o << setw(11) << "q_itor"
 	      << setw(11) << sym_tab->get_symbol(sym1)
@@ -776,6 +1076,84 @@ void quadruple::print(ostream& o) {
 	      << setw(11) << sym_tab->get_symbol(sym2)
 	      << setw(11) << "-";
 	    break;
+	case q_jmpt:
+	    o << setw(11) << "q_jmpt"
+	      << setw(11) << int1
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << "-";
+	    break;
+	case q_jieq:
+	    o << setw(11) << "q_jieq"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jine:
+	    o << setw(11) << "q_jine"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jilt:
+	    o << setw(11) << "q_jilt"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jige:
+	    o << setw(11) << "q_jige"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jigt:
+	    o << setw(11) << "q_jigt"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jile:
+	    o << setw(11) << "q_jile"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jreq:
+	    o << setw(11) << "q_jreq"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jrne:
+	    o << setw(11) << "q_jrne"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jrlt:
+	    o << setw(11) << "q_jrlt"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jrge:
+	    o << setw(11) << "q_jrge"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jrgt:
+	    o << setw(11) << "q_jrgt"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
+	case q_jrle:
+	    o << setw(11) << "q_jrle"
+	      << setw(11) << sym_tab->get_symbol(sym1)
+	      << setw(11) << sym_tab->get_symbol(sym2)
+	      << setw(11) << int3;
+	    break;
 	case q_param:
 	    o << setw(11) << "q_param"
 	      << setw(11) << sym_tab->get_symbol(sym1)
@@ -14,7 +14,15 @@ class ast_binaryrelation;
    of arguments they take. Note that 'int' can be either int or real, since
    we're representing reals as ieee 32-bit integers when we have come this
    far in the compiling. 'sym' is a sym_index, which is just a typedef for
-   a long int (see symtab.hh). '-' means the argument is not used. */
+   a long int (see symtab.hh). '-' means the argument is not used.
+   q_rfetch and q_ifetch read the array element at an address computed by
+   q_lindex, the way q_rstore and q_istore write one. They are only created
+   by the quad optimizer, for array accesses it has turned into pointers.
+   The conditional jumps from q_jieq to q_jrle jump to the label int3 if the
+   relation holds between sym1 and sym2. The quad optimizer makes them out
+   of a relation followed by q_jmpf or q_jmpt, as its very last step, so
+   they are only seen by the code generator. For reals, q_jrge and q_jrle
+   mean "not less than" and "not greater than". */
 typedef enum {
     q_rload,       // int, -, sym
     q_iload,       // int, -, sym
@@ -50,15 +58,37 @@ typedef enum {
     q_lindex,      // sym, sym, sym
     q_rrindex,     // sym, sym, sym
     q_irindex,     // sym, sym, sym
+    q_rfetch,      // sym, -, sym
+    q_ifetch,      // sym, -, sym
     q_itor,        // sym, -, sym
     q_jmp,         // int, -, -
     q_jmpf,        // int, sym, -
+    q_jmpt,        // int, sym, -
+    q_jieq,        // sym, sym, int
+    q_jine,        // sym, sym, int
+    q_jilt,        // sym, sym, int
+    q_jige,        // sym, sym, int
+    q_jigt,        // sym, sym, int
+    q_jile,        // sym, sym, int
+    q_jreq,        // sym, sym, int
+    q_jrne,        // sym, sym, int
+    q_jrlt,        // sym, sym, int
+    q_jrge,        // sym, sym, int
+    q_jrgt,        // sym, sym, int
+    q_jrle,        // sym, sym, int
     q_param,       // sym, -, -
     q_labl,        // int, -, -
     q_nop          // -, -, -
 } quad_op_type;
 	
 
+/* The maximum number of symbols a single quad can read. */
+const int MAX_QUAD_USES = 2;
+
+/* The maximum number of symbols a single quad can mention. */
+const int MAX_QUAD_SYMBOLS = MAX_QUAD_USES + 2;
+
+
 /* There already exists some "quad" struct in the solaris include files...
   *mutter* */
 class quadruple;
@@ -92,6 +122,24 @@ public:
     quadruple(quad_op_type, int, sym_index, sym_index);
     quadruple(quad_op_type, sym_index, int, sym_index);
 
+    // These are used by the quad optimizer (see quadopt.cc), so that the
+    // knowledge of which argument fields a quad reads and writes is kept in
+    // one place.
+    sym_index get_def();                       // Symbol written, or NULL_SYM.
+    int       get_uses(sym_index *);           // Fill in the symbols read
+                                               // (at most MAX_QUAD_USES),
+                                               // return how many they are.
+    void      replace_use(sym_index, sym_index); // Args: old, new symbol.
+    int       get_symbols(sym_index *);        // Fill in all the symbols
+                                               // mentioned (at most
+                                               // MAX_QUAD_SYMBOLS), return
+                                               // how many they are.
+    int       get_outer_refs(int, sym_index *); // The same, but only the
+                                               // variables, parameters and
+                                               // arrays at most at the given
+                                               // level, ie, those of the
+                                               // enclosing routines.
+
     friend ostream& operator<<(ostream &, quadruple *);
 };
 
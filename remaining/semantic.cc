@@ -11,13 +11,69 @@ semantic *type_checker = new semantic();
 static int has_return = 0;
 
 
+/* The effects of the routine being checked, and the routine itself. As we
+   go, we note the variables declared outside it which it reads and writes,
+   and add the effects of the routines it calls. The summary is stored in
+   the routine's symbol when we're done, for the quad optimizer to use. */
+static effect_summary *effects = NULL;
+static symbol *effects_env = NULL;
+
+
+/* Note a read or write of a symbol, if it is declared outside the routine
+   we're checking. */
+static void note_access(sym_index sym_p, int is_write) {
+    if(effects == NULL)
+	return;
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if((sym->tag != SYM_VAR && sym->tag != SYM_PARAM &&
+	sym->tag != SYM_ARRAY) || sym->level > effects_env->level)
+	return;
+    if(is_write)
+	effects->add_write(sym_p);
+    else
+	effects->add_read(sym_p);
+}
+
+
+/* Add the effects of a call to the routine we're checking. What the callee
+   does to its own outer symbols we may do too, except to those declared
+   inside us, which are our own business. A call to ourselves adds
+   nothing. */
+static void note_call(sym_index callee_p) {
+    if(effects == NULL || sym_tab->get_symbol(callee_p) == effects_env)
+	return;
+    effect_summary *callee = sym_tab->get_effects(callee_p);
+    if(callee == NULL) {
+	effects->is_complete = 0;
+	return;
+    }
+    if(!callee->is_complete)
+	effects->is_complete = 0;
+    if(callee->does_io)
+	effects->does_io = 1;
+    int i;
+    for(i = 0; i < callee->nr_reads; i++)
+	note_access(callee->reads[i], 0);
+    for(i = 0; i < callee->nr_writes; i++)
+	note_access(callee->writes[i], 1);
+}
+
+
 /* Interface for type checking a block of code represented as an AST node. */
 void semantic::do_typecheck(symbol *env, ast_stmt_list *body) {
     // Reset the variable, since we're checking a new block of code.
     has_return = 0;
+    effects = new effect_summary();
+    effects_env = env;
     if(body)
 	body->type_check();
 
+    if(env->tag == SYM_FUNC)
+	env->get_function_symbol()->effects = effects;
+    else if(env->tag == SYM_PROC)
+	env->get_procedure_symbol()->effects = effects;
+    effects = NULL;
+
     // This is the only case we need this variable for - a function lacking
     // a return statement. All other cases are already handled in
     // ast_return::type_check(); see below.
@@ -155,6 +211,7 @@ sym_index ast_elsif_list::type_check() {
    here, since all nametypes are of type void, but should return an index to
    itself in the symbol table as far as typechecking is concerned. */
 sym_index ast_id::type_check() {
+    note_access(sym_p, 0);
     if(sym_tab->get_symbol(sym_p)->tag != SYM_NAMETYPE)
 	return type;
     return sym_p;
@@ -319,6 +376,7 @@ sym_index ast_greaterthan::type_check() {
 sym_index ast_procedurecall::type_check() {
     /* Your code here. */
     id->type_check();
+    note_call(id->sym_p);
 
     // if (parameter_list)
     // 	parameter_list->type_check();
@@ -332,6 +390,10 @@ sym_index ast_assign::type_check() {
     /* Your code here. */
     sym_index ltype = lhs->type_check();
     sym_index rtype = rhs->type_check();
+    if(lhs->tag == AST_ID)
+	note_access(lhs->get_ast_id()->sym_p, 1);
+    else
+	note_access(static_cast<ast_indexed *>(lhs)->id->sym_p, 1);
     if (ltype != rtype)
 	{
 	    if (ltype == real_type && rtype == integer_type)
@@ -424,6 +486,7 @@ sym_index ast_return::type_check() {
 sym_index ast_functioncall::type_check() {
     /* Your code here. */
     sym_index ret_type = id->type_check();
+    note_call(id->sym_p);
 
     type_checker->check_parameters(id, parameter_list);
     type = ret_type;
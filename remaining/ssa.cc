@@ -0,0 +1,535 @@
+#include <iostream>
+#include "ssa.hh"
+#include "dataflow.hh"
+
+using namespace std;
+
+
+/* The phi_node constructor. A new phi node for a symbol has one argument
+   per predecessor of the block, all of them the symbol itself until the
+   renaming fills in the right versions. */
+phi_node::phi_node(sym_index v, basic_block *b, flow_graph *cfg) :
+    var(v),
+    dest(v),
+    nr_args(b->nr_pred),
+    next(NULL)
+{
+    args = new sym_index[nr_args + 1];
+    from = new basic_block *[nr_args + 1];
+    for(int i = 0; i < nr_args; i++) {
+	args[i] = v;
+	from[i] = cfg->blocks[b->pred[i]];
+    }
+}
+
+
+/* Remove the argument coming from a block. Used when an edge disappears. */
+void phi_node::remove_arg(basic_block *b) {
+    for(int i = 0; i < nr_args; i++)
+	if(from[i] == b) {
+	    for(int j = i; j < nr_args - 1; j++) {
+		args[j] = args[j + 1];
+		from[j] = from[j + 1];
+	    }
+	    nr_args--;
+	    return;
+	}
+}
+
+
+
+/* The ssa_form constructor. We do the conversion the classic way, as
+   described by Cytron et al:
+
+     1. Compute the dominator tree and the dominance frontiers. The
+        dominance frontier of block b is the set of blocks where b's
+        dominance ends, ie, the blocks which have a predecessor dominated by
+        b but which aren't strictly dominated by b themselves. Those are
+        exactly the places where an assignment in b meets other values.
+     2. Place phi nodes for every renamed symbol in the dominance frontiers
+        of the blocks assigning it, and in the frontiers of those phi nodes
+        in turn (since a phi node is an assignment too). We skip blocks
+        where the symbol isn't live, since such a phi node would never be
+        read anyway (this is called pruned SSA form).
+     3. Walk the dominator tree, giving every assignment a new version and
+        changing every read to the version in effect at that point. */
+ssa_form::ssa_form(flow_graph *g) :
+    cfg(g),
+    nr_saved(0),
+    max_saved(BASE_BLOCK_SIZE)
+{
+    renamable = new char[MAX_SYM];
+    current = new sym_index[MAX_SYM];
+    origin = new sym_index[MAX_SYM];
+    use_count = new int[MAX_SYM];
+    for(int i = 0; i < MAX_SYM; i++) {
+	renamable[i] = 0;
+	current[i] = i;
+	origin[i] = NULL_SYM;
+	use_count[i] = 0;
+    }
+    saved_sym = new sym_index[max_saved];
+    saved_version = new sym_index[max_saved];
+
+    // Phi nodes only make sense in blocks that can be reached, and the
+    // first block must not be a join point, since there is nowhere to put
+    // the argument for the value coming into the routine.
+    cfg->remove_unreachable();
+    cfg->make_entry_block();
+    dom = new dominator_tree(cfg);
+
+    find_renamable();
+    place_phis();
+    rename(0);
+}
+
+
+
+ssa_form::~ssa_form() {
+    delete[] renamable;
+    delete[] current;
+    delete[] origin;
+    delete[] use_count;
+    delete[] saved_sym;
+    delete[] saved_version;
+}
+
+
+
+/* Decide which symbols to rename. A temporary which is assigned only once is
+   in SSA form already, and so needs no renaming. The variables and
+   parameters of the routine are renamed only if no routine called may read
+   or change them behind our back. Only routines nested inside it can see
+   them at all, and of those, the ones whose effect summary says they leave
+   them alone don't count. */
+void ssa_form::find_renamable() {
+    int level = cfg->env->level + 1;
+    int *defs = new int[MAX_SYM];
+    sym_index *callees = new sym_index[MAX_SYM];
+    int nr_callees = 0;
+    int i, j;
+
+    for(i = 0; i < MAX_SYM; i++)
+	defs[i] = 0;
+
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    if(q->op_code == q_call &&
+	       sym_tab->get_symbol(q->sym1)->level >= level &&
+	       nr_callees < MAX_SYM)
+		callees[nr_callees++] = q->sym1;
+	    if(q->get_def() != NULL_SYM)
+		defs[q->get_def()]++;
+	}
+    }
+
+    for(i = 0; i < MAX_SYM; i++) {
+	if(defs[i] == 0)
+	    continue;
+	if(sym_tab->is_temp_var(i))
+	    renamable[i] = (defs[i] > 1);
+	else if(is_scalar_symbol(i) &&
+		sym_tab->get_symbol(i)->level == level) {
+	    renamable[i] = 1;
+	    for(j = 0; j < nr_callees; j++)
+		if(may_be_accessed(callees[j], i))
+		    renamable[i] = 0;
+	}
+    }
+
+    delete[] defs;
+    delete[] callees;
+}
+
+
+
+/* Place the phi nodes. See the constructor. */
+void ssa_form::place_phis() {
+    int n = cfg->nr_blocks;
+    int i, j;
+
+    // The dominance frontiers, computed with the method of Cooper, Harvey
+    // and Kennedy: for each join point, walk up the dominator tree from each
+    // predecessor until we reach the join point's immediate dominator. The
+    // join point is in the frontier of every block we pass on the way.
+    bit_set **frontier = new bit_set *[n];
+    for(i = 0; i < n; i++)
+	frontier[i] = new bit_set(n);
+    for(i = 0; i < n; i++) {
+	basic_block *b = cfg->blocks[i];
+	if(b->nr_pred < 2 || dom->rpo_nr[i] < 0)
+	    continue;
+	for(j = 0; j < b->nr_pred; j++) {
+	    int runner = b->pred[j];
+	    if(dom->rpo_nr[runner] < 0)
+		continue;
+	    while(runner != dom->idom[i]) {
+		frontier[runner]->add(i);
+		runner = dom->idom[runner];
+	    }
+	}
+    }
+
+    // The symbols assigned in each block.
+    bit_set **assigned = new bit_set *[n];
+    for(i = 0; i < n; i++) {
+	basic_block *b = cfg->blocks[i];
+	assigned[i] = new bit_set(MAX_SYM);
+	for(j = 0; j < b->nr_quads; j++)
+	    if(b->quads[j]->get_def() != NULL_SYM)
+		assigned[i]->add(b->quads[j]->get_def());
+    }
+
+    liveness *live = new liveness(cfg);
+
+    // For each renamed symbol, a worklist of blocks assigning it. has_phi
+    // and in_work record the last symbol handled, so they don't have to be
+    // cleared between symbols.
+    int *work = new int[n];
+    sym_index *has_phi = new sym_index[n];
+    sym_index *in_work = new sym_index[n];
+    for(i = 0; i < n; i++) {
+	has_phi[i] = NULL_SYM;
+	in_work[i] = NULL_SYM;
+    }
+
+    for(sym_index sym_p = 0; sym_p < MAX_SYM; sym_p++) {
+	if(!renamable[sym_p])
+	    continue;
+
+	int nr_work = 0;
+	for(i = 0; i < n; i++)
+	    if(assigned[i]->member(sym_p)) {
+		work[nr_work++] = i;
+		in_work[i] = sym_p;
+	    }
+
+	while(nr_work > 0) {
+	    int d = work[--nr_work];
+	    for(i = 0; i < n; i++) {
+		if(!frontier[d]->member(i) || has_phi[i] == sym_p ||
+		   !live->in[i]->member(sym_p))
+		    continue;
+
+		basic_block *f = cfg->blocks[i];
+		phi_node *phi = new phi_node(sym_p, f, cfg);
+		phi->next = f->phis;
+		f->phis = phi;
+		has_phi[i] = sym_p;
+
+		if(in_work[i] != sym_p) {
+		    work[nr_work++] = i;
+		    in_work[i] = sym_p;
+		}
+	    }
+	}
+    }
+
+    for(i = 0; i < n; i++) {
+	delete frontier[i];
+	delete assigned[i];
+    }
+    delete[] frontier;
+    delete[] assigned;
+    delete[] work;
+    delete[] has_phi;
+    delete[] in_work;
+    delete live;
+}
+
+
+
+/* Create a new version of a symbol. */
+sym_index ssa_form::new_version(sym_index sym_p) {
+    sym_index version = sym_tab->gen_temp_var(sym_tab->get_symbol_type(sym_p));
+    origin[version] = sym_p;
+    return version;
+}
+
+
+/* Make a version the current one of its symbol, remembering the old one so
+   rename() can restore it when it leaves the part of the dominator tree
+   where the new version is in effect. */
+void ssa_form::set_current(sym_index sym_p, sym_index version) {
+    if(nr_saved == max_saved) {
+	sym_index *new_sym = new sym_index[max_saved * 2];
+	sym_index *new_version = new sym_index[max_saved * 2];
+	for(int i = 0; i < nr_saved; i++) {
+	    new_sym[i] = saved_sym[i];
+	    new_version[i] = saved_version[i];
+	}
+	delete[] saved_sym;
+	delete[] saved_version;
+	saved_sym = new_sym;
+	saved_version = new_version;
+	max_saved *= 2;
+    }
+    saved_sym[nr_saved] = sym_p;
+    saved_version[nr_saved++] = current[sym_p];
+    current[sym_p] = version;
+}
+
+
+/* Rename the symbols in a block and in the blocks it dominates. Before the
+   first assignment, the current version of a symbol is the symbol itself,
+   which stands for the value it had when the routine was entered. */
+void ssa_form::rename(int b_nr) {
+    basic_block *b = cfg->blocks[b_nr];
+    sym_index uses[MAX_QUAD_USES];
+    int mark = nr_saved;
+    phi_node *phi;
+    int i;
+
+    for(phi = b->phis; phi != NULL; phi = phi->next) {
+	phi->dest = new_version(phi->var);
+	set_current(phi->var, phi->dest);
+    }
+
+    for(i = 0; i < b->nr_quads; i++) {
+	quadruple *q = b->quads[i];
+
+	// Reads first, since a quad may read the symbol it assigns.
+	int nr_uses = q->get_uses(uses);
+	for(int u = 0; u < nr_uses; u++)
+	    if(uses[u] != NULL_SYM && renamable[uses[u]])
+		q->replace_use(uses[u], current[uses[u]]);
+
+	sym_index def = q->get_def();
+	if(def != NULL_SYM && renamable[def]) {
+	    q->sym3 = new_version(def);
+	    set_current(def, q->sym3);
+	}
+    }
+
+    // Fill in our arguments to the phi nodes of the successors.
+    for(i = 0; i < b->nr_succ; i++)
+	for(phi = cfg->blocks[b->succ[i]]->phis; phi != NULL; phi = phi->next)
+	    for(int k = 0; k < phi->nr_args; k++)
+		if(phi->from[k] == b)
+		    phi->args[k] = current[phi->var];
+
+    for(i = 0; i < dom->nr_children[b_nr]; i++)
+	rename(dom->children[b_nr][i]);
+
+    while(nr_saved > mark) {
+	nr_saved--;
+	current[saved_sym[nr_saved]] = saved_version[nr_saved];
+    }
+}
+
+
+
+/* Remove phi arguments coming from blocks which no longer are predecessors,
+   eg, because a jump has been removed. The edges must be up to date. */
+void ssa_form::update_phis() {
+    for(int i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(phi_node *phi = b->phis; phi != NULL; phi = phi->next)
+	    for(int k = phi->nr_args - 1; k >= 0; k--) {
+		int j;
+		for(j = 0; j < b->nr_pred; j++)
+		    if(cfg->blocks[b->pred[j]] == phi->from[k])
+			break;
+		if(j == b->nr_pred)
+		    phi->remove_arg(phi->from[k]);
+	    }
+    }
+}
+
+
+
+/* Count the reads of every symbol, phi arguments included. */
+void ssa_form::count_uses() {
+    sym_index uses[MAX_QUAD_USES];
+    int i;
+
+    for(i = 0; i < MAX_SYM; i++)
+	use_count[i] = 0;
+
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(int j = 0; j < b->nr_quads; j++) {
+	    int nr_uses = b->quads[j]->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++)
+		if(uses[u] != NULL_SYM)
+		    use_count[uses[u]]++;
+	}
+	for(phi_node *phi = b->phis; phi != NULL; phi = phi->next)
+	    for(int k = 0; k < phi->nr_args; k++)
+		use_count[phi->args[k]]++;
+    }
+}
+
+
+/* Dead code elimination on SSA form. Since every version has exactly one
+   assignment, a version which is never read is simply dead, and so is its
+   assignment. Unlike the dead code elimination in quadopt.cc, this also
+   finds dead assignments of the routine's own variables, and dead phi
+   nodes. Jumps to the next block are removed as we go, since the
+   conditions they test may then become dead too. */
+int ssa_form::dead_code_elimination() {
+    int changed = 0;
+    int found;
+
+    do {
+	found = cfg->remove_useless_jumps();
+	count_uses();
+	for(int i = 0; i < cfg->nr_blocks; i++) {
+	    basic_block *b = cfg->blocks[i];
+
+	    phi_node **link = &b->phis;
+	    while(*link != NULL) {
+		if(use_count[(*link)->dest] == 0) {
+		    *link = (*link)->next;
+		    found = 1;
+		} else
+		    link = &(*link)->next;
+	    }
+
+	    for(int j = 0; j < b->nr_quads; j++) {
+		quadruple *q = b->quads[j];
+		sym_index dest = q->get_def();
+
+		if(dest == NULL_SYM || use_count[dest] != 0 ||
+		   (origin[dest] == NULL_SYM && !sym_tab->is_temp_var(dest)))
+		    continue;
+
+		if(q->op_code == q_call)
+		    q->sym3 = NULL_SYM;
+		else
+		    b->remove(j--);
+		found = 1;
+	    }
+	}
+	changed |= found;
+    } while(found);
+
+    return changed;
+}
+
+
+
+/* Insert a list of copies on the edge from block p to block b. If p has no
+   other successor, the copies can go last in it (before its jump, if it
+   has one). Otherwise the edge is critical, and we have to give it a block
+   of its own, so the copies aren't done when going the other way. */
+void ssa_form::insert_copies(basic_block *p, basic_block *b,
+			     quadruple **copies, int nr_copies) {
+    quadruple *last = p->get_last();
+    basic_block *target = p;
+    int pos = p->nr_quads;
+    int i;
+
+    if(last != NULL &&
+       (last->op_code == q_jmpf || last->op_code == q_jmpt)) {
+	if(b->nr == p->nr + 1 && last->int1 == b->get_label()) {
+	    // Both ways lead to b, so the jump is useless.
+	    p->remove(--pos);
+	} else if(b->nr == p->nr + 1) {
+	    // The edge is the fall through one: put the new block in between.
+	    target = cfg->insert_block(p->nr + 1);
+	    pos = 0;
+	} else {
+	    // The edge is the jump: put the new block right before b, with a
+	    // label of its own to jump to. Whatever fell through to b before
+	    // has to jump to it instead.
+	    int label = sym_tab->get_next_label();
+	    quadruple *prev = cfg->blocks[b->nr - 1]->get_last();
+	    if(prev == NULL || (prev->op_code != q_jmp &&
+				prev->op_code != q_ireturn &&
+				prev->op_code != q_rreturn))
+		cfg->insert_block(b->nr)->append(
+		    new quadruple(q_jmp, b->get_label(), NULL_SYM, NULL_SYM));
+	    target = cfg->insert_block(b->nr);
+	    target->append(new quadruple(q_labl, label, NULL_SYM, NULL_SYM));
+	    last->int1 = label;
+	    pos = 1;
+	}
+    } else if(last != NULL && (last->op_code == q_jmp ||
+			       last->op_code == q_ireturn ||
+			       last->op_code == q_rreturn))
+	pos--;
+
+    for(i = 0; i < nr_copies; i++)
+	target->insert(pos++, copies[i]);
+}
+
+
+/* Convert the flow graph back to ordinary quads. See ssa.hh. */
+void ssa_form::destruct() {
+    sym_index uses[MAX_QUAD_USES];
+    int i, j, k;
+
+    // insert_copies() adds blocks as it goes, so take a copy of the list.
+    int nr_blocks = cfg->nr_blocks;
+    basic_block **blocks = new basic_block *[nr_blocks];
+    for(i = 0; i < nr_blocks; i++)
+	blocks[i] = cfg->blocks[i];
+
+    for(i = 0; i < nr_blocks; i++) {
+	basic_block *b = blocks[i];
+	if(b->phis == NULL)
+	    continue;
+
+	int nr_phis = 0;
+	phi_node *phi;
+	for(phi = b->phis; phi != NULL; phi = phi->next)
+	    nr_phis++;
+	quadruple **copies = new quadruple *[nr_phis];
+
+	// All phi nodes of a block have their arguments in the same order.
+	for(k = 0; k < b->phis->nr_args; k++) {
+	    int nr_copies = 0;
+	    for(phi = b->phis; phi != NULL; phi = phi->next) {
+		sym_index arg = phi->args[k];
+		if(arg == phi->var || origin[arg] == phi->var)
+		    continue;
+		copies[nr_copies++] =
+		    new quadruple(sym_tab->get_symbol_type(phi->var) == real_type
+				  ? q_rassign : q_iassign,
+				  arg, NULL_SYM, phi->var);
+	    }
+	    if(nr_copies > 0)
+		insert_copies(b->phis->from[k], b, copies, nr_copies);
+	}
+
+	delete[] copies;
+	b->phis = NULL;
+    }
+    delete[] blocks;
+
+    // Coalesce all versions with their original symbol again.
+    for(i = 0; i < cfg->nr_blocks; i++) {
+	basic_block *b = cfg->blocks[i];
+	for(j = 0; j < b->nr_quads; j++) {
+	    quadruple *q = b->quads[j];
+	    int nr_uses = q->get_uses(uses);
+	    for(int u = 0; u < nr_uses; u++)
+		if(uses[u] != NULL_SYM && origin[uses[u]] != NULL_SYM)
+		    q->replace_use(uses[u], origin[uses[u]]);
+	    sym_index def = q->get_def();
+	    if(def != NULL_SYM && origin[def] != NULL_SYM)
+		q->sym3 = origin[def];
+	}
+    }
+
+    cfg->compute_edges();
+}
+
+
+
+/* Print the phi nodes of a block, in the same style as the quads. */
+void ssa_form::print_phis(ostream &o, basic_block *b) {
+    for(phi_node *phi = b->phis; phi != NULL; phi = phi->next) {
+	o << "    " << short_symbols << sym_tab->get_symbol(phi->dest)
+	  << " := phi(";
+	for(int k = 0; k < phi->nr_args; k++) {
+	    if(k > 0)
+		o << ", ";
+	    o << sym_tab->get_symbol(phi->args[k]);
+	}
+	o << ")" << long_symbols << endl;
+    }
+}
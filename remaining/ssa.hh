@@ -0,0 +1,123 @@
+#ifndef __SSA_HH__
+#define __SSA_HH__
+
+#include <iostream>
+#include "symtab.hh"
+#include "quads.hh"
+#include "flowgraph.hh"
+
+using namespace std;
+
+
+/* This file contains the conversion of a flow graph to and from static
+   single assignment (SSA) form. In SSA form every symbol we rename is
+   assigned in exactly one place: each assignment gets a new symbol of its
+   own (a version of the original), and every read is changed to read the
+   version whose assignment reaches it. Where several versions reach the
+   start of a block through different predecessors, a phi node picks the
+   right one:
+
+       X.3 := phi(X.1, X.2)
+
+   means "X.3 is X.1 if we came from the first predecessor, X.2 if we came
+   from the second". (In the quads, the versions are temporaries like any
+   other, so they show up as $17 rather than X.3.) Since every value then
+   has a single definition, passes like constant propagation can follow
+   values directly from definition to use, instead of iterating over sets
+   of variables.
+
+   We only rename symbols that no one else can see: temporaries, and the
+   variables and parameters of the routine itself, provided it doesn't call
+   any routine nested inside it (which could read or write them). Everything
+   else is left as it is, and must be treated like memory.
+
+   The versions are ordinary temporaries, so the flow graph still only
+   contains ordinary quads. The phi nodes are kept in a list on each block,
+   since they have a varying number of arguments and must not be seen by the
+   passes that don't know about SSA form.
+
+   Converting back is simple as long as the passes working on SSA form only
+   replace reads of a version by a constant, or remove code. Then no two
+   versions of the same symbol are ever alive at the same time, so all of
+   them can share the storage of the original again (they are coalesced).
+   A phi argument which isn't a version of the phi's own symbol (such as a
+   constant, if a pass puts one there) is turned into a copy at the end of
+   the predecessor it comes from. */
+
+
+class phi_node;
+class ssa_form;
+
+
+/* A phi node. The arguments are kept together with the predecessor block
+   they come from, so they stay right even if blocks are renumbered. */
+class phi_node {
+public:
+    sym_index     var;          // The original symbol.
+    sym_index     dest;         // The version the phi node defines.
+    sym_index    *args;         // One argument per predecessor.
+    basic_block **from;         // The predecessor each argument comes from.
+    int           nr_args;
+    phi_node     *next;         // Next phi node in the same block.
+
+    phi_node(sym_index, basic_block *, flow_graph *);
+
+    // Remove the argument coming from a block, if there is one.
+    void          remove_arg(basic_block *);
+};
+
+
+
+/* The SSA form of a flow graph. */
+class ssa_form {
+private:
+    flow_graph     *cfg;
+
+    char           *renamable;  // Symbol -> 1 if we rename it.
+    sym_index      *current;    // Symbol -> version currently in effect.
+    sym_index      *saved_sym;  // Undo log for current, used while renaming.
+    sym_index      *saved_version;
+    int             nr_saved;
+    int             max_saved;
+
+    void            find_renamable();
+    void            place_phis();
+    void            rename(int);
+    void            set_current(sym_index, sym_index);
+    sym_index       new_version(sym_index);
+
+    // Insert copies on the edge from a block to another.
+    void            insert_copies(basic_block *, basic_block *,
+				  quadruple **, int);
+
+public:
+    dominator_tree *dom;
+    sym_index      *origin;     // Version -> original symbol, NULL_SYM for
+                                // symbols which aren't versions.
+    int            *use_count;  // Nr of reads of each symbol, counting phi
+                                // arguments. Updated by count_uses().
+
+    // Constructor. Converts the flow graph to SSA form.
+    ssa_form(flow_graph *);
+    ~ssa_form();
+
+    // Count the reads of all symbols, including phi arguments.
+    void            count_uses();
+
+    // Remove the phi arguments coming from blocks which are no longer
+    // predecessors. Must be called by passes removing edges.
+    void            update_phis();
+
+    // Remove assignments of renamed symbols which are never read. Returns 1
+    // if something was removed.
+    int             dead_code_elimination();
+
+    // Convert the flow graph back to ordinary quads.
+    void            destruct();
+
+    // Print the phi nodes of a block.
+    void            print_phis(ostream &, basic_block *);
+};
+
+
+#endif
@@ -10,6 +10,7 @@ symbol::symbol(pool_index pool_p) {
     id = pool_p;
     tag = SYM_UNDEF;      // All symbols are tagged as SYM_UNDEF at creation.
                           // This is used later to check for redeclarations.
+    reg = NO_REGISTER;    // Set by the quad optimizer, see quadopt.cc.
 }
 
 
@@ -52,6 +53,7 @@ parameter_symbol::parameter_symbol(const pool_index pool_p) :
 {
     size = 0;
     preceding = NULL;
+    live_on_entry = 1;
 }
 
 
@@ -61,7 +63,10 @@ procedure_symbol::procedure_symbol(const pool_index pool_p) :
 {
     ar_size = 0;
     label_nr = 0;
+    is_leaf = 0;
+    sets_display = 0;
     last_parameter = NULL;
+    effects = NULL;
 }
 
 
@@ -71,7 +76,85 @@ function_symbol::function_symbol(const pool_index pool_p) :
 {
     ar_size = 0;
     label_nr = 0;
+    is_leaf = 0;
+    sets_display = 0;
     last_parameter = NULL;
+    effects = NULL;
+}
+
+
+
+/* Constructor for effect_summary. It starts out knowing of no effects. */
+effect_summary::effect_summary() {
+    max_reads = 8;
+    reads = new sym_index[max_reads];
+    nr_reads = 0;
+    max_writes = 8;
+    writes = new sym_index[max_writes];
+    nr_writes = 0;
+    does_io = 0;
+    is_complete = 1;
+}
+
+
+/* Add a symbol the routine may read, unless it's already there. */
+void effect_summary::add_read(sym_index sym_p) {
+    if(may_read(sym_p))
+	return;
+    if(nr_reads == max_reads) {
+	sym_index *new_reads = new sym_index[max_reads * 2];
+	for(int i = 0; i < nr_reads; i++)
+	    new_reads[i] = reads[i];
+	delete[] reads;
+	reads = new_reads;
+	max_reads *= 2;
+    }
+    reads[nr_reads++] = sym_p;
+}
+
+
+/* Add a symbol the routine may write, unless it's already there. */
+void effect_summary::add_write(sym_index sym_p) {
+    if(may_write(sym_p))
+	return;
+    if(nr_writes == max_writes) {
+	sym_index *new_writes = new sym_index[max_writes * 2];
+	for(int i = 0; i < nr_writes; i++)
+	    new_writes[i] = writes[i];
+	delete[] writes;
+	writes = new_writes;
+	max_writes *= 2;
+    }
+    writes[nr_writes++] = sym_p;
+}
+
+
+int effect_summary::may_read(sym_index sym_p) {
+    for(int i = 0; i < nr_reads; i++)
+	if(reads[i] == sym_p)
+	    return 1;
+    return 0;
+}
+
+
+int effect_summary::may_write(sym_index sym_p) {
+    for(int i = 0; i < nr_writes; i++)
+	if(writes[i] == sym_p)
+	    return 1;
+    return 0;
+}
+
+
+int effect_summary::writes_array() {
+    for(int i = 0; i < nr_writes; i++)
+	if(sym_tab->get_symbol_tag(writes[i]) == SYM_ARRAY)
+	    return 1;
+    return 0;
+}
+
+
+int effect_summary::is_pure() {
+    return is_complete && !does_io && nr_reads == 0 && nr_writes == 0;
 }
 
 
@@ -286,6 +369,8 @@ void procedure_symbol::print(ostream& o) {
 	    o << "  class:     procedure_symbol" << endl;
 	    o << "  ar_size:   " << ar_size << endl;
 	    o << "  label_nr:  " << label_nr << endl;
+	    o << "  is_leaf:   " << is_leaf << endl;
+	    o << "  sets_display: " << sets_display << endl;
 	    o << "  params:    ";
 	    
 	    if(last_parameter == NULL)
@@ -335,6 +420,8 @@ void function_symbol::print(ostream& o) {
 	    o << "  class:     function_symbol" << endl;
 	    o << "  ar_size:   " << ar_size << endl;
 	    o << "  label_nr:  " << label_nr << endl;
+	    o << "  is_leaf:   " << is_leaf << endl;
+	    o << "  sets_display: " << sets_display << endl;
 	    o << "  params:    ";
 	    
 	    if(last_parameter == NULL)
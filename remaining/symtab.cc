@@ -110,6 +110,9 @@ symbol_table::symbol_table() {
     // Add the read() function. It returns an integer and takes no arguments.
     tmp = enter_function(dummy_pos, pool_install(capitalize("read")));
     sym_table[tmp]->type = integer_type;
+    func = sym_table[tmp]->get_function_symbol();
+    func->effects = new effect_summary();
+    func->effects->does_io = 1;
 
     // Add the write(int-arg) procedure. It takes an integer argument.
     // We need to set the parameter links by hand here since the global
@@ -125,6 +128,8 @@ symbol_table::symbol_table() {
     proc = sym->get_procedure_symbol();
     par = sym2->get_parameter_symbol();
     proc->last_parameter = par;
+    proc->effects = new effect_summary();
+    proc->effects->does_io = 1;
 
     // Add the trunc(real-arg) function. It returns an integer and takes
     // a real argument.
@@ -145,6 +150,7 @@ symbol_table::symbol_table() {
     par->preceding = NULL;
     par->offset = 0;
     func->last_parameter = par; // ...which is now real-arg only.
+    func->effects = new effect_summary(); // It has none.
 
     proc = sym_table[0]->get_procedure_symbol();
     proc->last_parameter = NULL;  
@@ -192,6 +198,117 @@ sym_index symbol_table::gen_temp_var(sym_index type) {
 }
 
 
+/* Return 1 if a symbol is a temporary variable created by gen_temp_var().
+   Temporaries are only ever used inside the routine which created them, so
+   the quad optimizer can treat them more freely than user variables. We
+   recognize them by the '$' which can't start a Diesel identifier. */
+int symbol_table::is_temp_var(const sym_index sym_p) {
+    if(sym_p == NULL_SYM || get_symbol_tag(sym_p) != SYM_VAR)
+	return 0;
+    // The first char of a string is stored right after its length byte.
+    return string_pool[get_symbol_id(sym_p) + 1] == '$';
+}
+
+
+/* Generate a temporary constant. These are used by the quad optimizer, which
+   replaces temporaries it knows the value of with constants. They are named
+   just like the temporary variables, but since they are constants they take
+   no space in the activation record. Reals are given as their ieee bit
+   pattern, just like in the q_rload quad. */
+sym_index symbol_table::gen_temp_const(sym_index type, int value) {
+    if (type != integer_type && type != real_type)
+	fatal("Invalid temporary constant type");
+    std::ostringstream oss;
+    ++temp_nr;
+    oss << '$' << temp_nr;
+    pool_index pool_p = pool_install(oss.str().c_str());
+    return enter_constant(NULL, pool_p, type, value);
+}
+
+
+/* Generate a variable of the current block standing in for a variable or
+   parameter of another routine. The quad optimizer uses these when it
+   inlines a routine. It is named like the original, followed by a '.' and a
+   number, which can't clash with a Diesel identifier. Unlike temporaries,
+   it may be read before it has been assigned, just like the original. */
+sym_index symbol_table::gen_copy_var(sym_index sym_p) {
+    char *name = pool_lookup(get_symbol_id(sym_p));
+    std::ostringstream oss;
+    ++temp_nr;
+    oss << name << '.' << temp_nr;
+    delete[] name;
+    pool_index pool_p = pool_install(oss.str().c_str());
+    return enter_variable(pool_p, get_symbol_type(sym_p));
+}
+
+
+/* Return the effect summary of a procedure or function (see symtab.hh), or
+   NULL if it isn't known, for instance because type checking was turned
+   off. */
+effect_summary *symbol_table::get_effects(const sym_index sym_p) {
+    symbol *sym = get_symbol(sym_p);
+    if(sym->tag == SYM_FUNC)
+	return sym->get_function_symbol()->effects;
+    if(sym->tag == SYM_PROC)
+	return sym->get_procedure_symbol()->effects;
+    return NULL;
+}
+
+
+/* Note that a variable, parameter or array is used by a routine nested
+   inside the one it belongs to, which reaches it through the display. The
+   routine it belongs to then has to set its display register. Its block
+   is still open, since the nested routine is in it. */
+void symbol_table::note_display_use(const sym_index sym_p) {
+    symbol *env = get_symbol(block_table[get_symbol(sym_p)->level]);
+    if(env->tag == SYM_FUNC)
+	env->get_function_symbol()->sets_display = 1;
+    else if(env->tag == SYM_PROC)
+	env->get_procedure_symbol()->sets_display = 1;
+}
+
+
+/* Generate a copy of a procedure or function, which the quad optimizer can
+   specialize for some of the calls to it. It has the same level,
+   parameters and return type as the original, and starts out with an
+   activation record of the same size, so that it can use the variables and
+   temporaries of the original as they are. It gets a label of its own, and
+   is named like the original, followed by a '.' and a number. It sets its
+   display register if the original does, since the routines nested inside
+   the original use the copy's frame too when it calls them. */
+sym_index symbol_table::gen_clone(sym_index routine_p) {
+    symbol *routine = get_symbol(routine_p);
+    char *name = pool_lookup(routine->id);
+    std::ostringstream oss;
+    ++temp_nr;
+    oss << name << '.' << temp_nr;
+    delete[] name;
+    pool_index pool_p = pool_install(oss.str().c_str());
+
+    sym_index clone_p;
+    if(routine->tag == SYM_FUNC) {
+	function_symbol *func = routine->get_function_symbol();
+	clone_p = enter_function(NULL, pool_p);
+	function_symbol *clone = get_symbol(clone_p)->get_function_symbol();
+	clone->ar_size = func->ar_size;
+	clone->sets_display = func->sets_display;
+	clone->last_parameter = func->last_parameter;
+	clone->effects = func->effects;
+    } else {
+	procedure_symbol *proc = routine->get_procedure_symbol();
+	clone_p = enter_procedure(NULL, pool_p);
+	procedure_symbol *clone = get_symbol(clone_p)->get_procedure_symbol();
+	clone->ar_size = proc->ar_size;
+	clone->sets_display = proc->sets_display;
+	clone->last_parameter = proc->last_parameter;
+	clone->effects = proc->effects;
+    }
+    get_symbol(clone_p)->type = routine->type;
+    get_symbol(clone_p)->level = routine->level;
+    return clone_p;
+}
+
+
 /* This function returns the byte size of a nametype. */
 
 int symbol_table::get_size(const sym_index type) {
@@ -577,6 +694,27 @@ sym_index symbol_table::close_scope() {
 }
 
 
+/* Make the block of a procedure or function the current one again, after
+   its scope has been closed. This is used when the quad optimizer works on
+   the whole program at once (the -w flag), so that the temporaries it
+   creates for a routine end up in the routine's activation record. Its
+   names can't be looked up again, but the optimizer doesn't need to. Since
+   the scopes inside the current one have all been closed, the part of
+   block_table we use is free. Returns the level to give to leave_scope(). */
+block_level symbol_table::reopen_scope(sym_index env_p) {
+    block_level old_level = current_level;
+    current_level = get_symbol(env_p)->level + 1;
+    block_table[current_level] = env_p;
+    return old_level;
+}
+
+
+/* Go back to the scope we were in before reopen_scope() was called. */
+void symbol_table::leave_scope(block_level old_level) {
+    current_level = old_level;
+}
+
+
 /*** Main symbol table methods. ***/
 
  /* Return a sym_index to the sought symbol (or 0 if none was found), given
@@ -704,6 +842,10 @@ sym_index symbol_table::install_symbol(const pool_index pool_p,
       // error
       break;
     };
+  // The optimizer creates symbols too, so it's not only huge programs that
+  // can fill up the table.
+  if (sym_pos + 1 >= MAX_SYM)
+    fatal("Symbol table full");
   hash_index hash_p = hash(pool_p);
   sym->hash_link = hash_table[hash_p];
   sym->back_link = hash_p;
@@ -28,9 +28,13 @@ typedef enum symbol_types sym_type;
 const block_level MAX_BLOCK = 8;            // Max allowed nesting levels.
 const hash_index  MAX_HASH = 512;           // Max size of hash table.
 const pool_index  BASE_POOL_SIZE = 1024;    // Base size of string pool.
-const sym_index   MAX_SYM = 1024;           // Max size of symbol table.
+const sym_index   MAX_SYM = 4096;           // Max size of symbol table. The
+                                            // quad optimizer creates a lot
+                                            // of temporaries (see ssa.hh).
 const sym_index   NULL_SYM = -1;            // Signifies 'no symbol'.
 const int         ILLEGAL_ARRAY_CARD = -1;  // Signifies a non-int array size.
+const int         NO_REGISTER = -1;         // Signifies a symbol kept in
+                                            // memory (see codegen.hh).
 
 /* Sets a limit for max nr of temporary variables. Should never be reached
    unless someone really, really starts to dig writing huge programs in
@@ -97,6 +101,8 @@ public:
     hash_index    back_link;  // Link back to the hash table. 
     block_level  level;      // Current block level, ie, nesting depth. 
     int          offset;     // Offset, used in code generation. 
+    int          reg;        // Register variable holding it, or
+                             // NO_REGISTER. Also used in code generation.
 
     // Constructor.
     symbol(pool_index);
@@ -203,6 +209,9 @@ protected:
 public:
     int               size;          // Nr of bytes parameter needs.
     parameter_symbol *preceding;     // Link to preceding parameter, if any.
+    int               live_on_entry; // 1 if it may be read before it is
+                                     // assigned. Set by the quad optimizer,
+                                     // see quadopt.cc.
 
     // Constructor. Args: identifier.
     parameter_symbol(const pool_index);
@@ -212,6 +221,38 @@ public:
 };
 
 
+/* What a procedure or function may do besides computing its result, as
+   found by the type checker (see semantic.cc). The symbols listed are the
+   variables, parameters and arrays declared outside the routine which it,
+   or any routine it calls, may read or write. If it calls a routine whose
+   body hasn't been checked yet (one it is nested in), we can't know what
+   that one does, so the summary is incomplete and says nothing. */
+class effect_summary {
+public:
+    sym_index *reads;             // Outer symbols it may read.
+    int        nr_reads;
+    int        max_reads;
+    sym_index *writes;            // Outer symbols it may write.
+    int        nr_writes;
+    int        max_writes;
+    int        does_io;           // 1 if it may call read or write.
+    int        is_complete;       // 0 if it may do anything at all.
+
+    effect_summary();
+
+    void add_read(sym_index);
+    void add_write(sym_index);
+    int  may_read(sym_index);
+    int  may_write(sym_index);
+    int  writes_array();          // 1 if it may write some array.
+
+    // 1 if its result only depends on its arguments, and calling it has no
+    // other effect, so that calls with the same arguments can share a
+    // result and a call whose result isn't used can be removed.
+    int  is_pure();
+};
+
+
 /* Derived symbol type, used for procedures. */
 class procedure_symbol: public symbol {
 protected:
@@ -220,9 +261,15 @@ protected:
 public:
     int               ar_size;         // Activation record size.
     int               label_nr;        // Assembler label number.
+    int               is_leaf;         // 1 if it runs in its caller's
+                                       // register window. See codegen.cc.
+    int               sets_display;    // 1 if a routine nested inside it
+                                       // uses its variables through the
+                                       // display. See quads.cc.
     parameter_symbol *last_parameter;  // List of parameters. We store them
                                        // in reverse order to make type 
                                        // checking easier later on.
+    effect_summary   *effects;         // NULL until its body is checked.
 
     // Constructor. Args: identifier.
     procedure_symbol(const pool_index);
@@ -240,9 +287,15 @@ protected:
 public:
     int               ar_size;         // Activation record size.
     int               label_nr;        // Assembler label number.
+    int               is_leaf;         // 1 if it runs in its caller's
+                                       // register window. See codegen.cc.
+    int               sets_display;    // 1 if a routine nested inside it
+                                       // uses its variables through the
+                                       // display. See quads.cc.
     parameter_symbol *last_parameter;  // List of parameters. We store them
                                        // in reverse order to make type 
                                        // checking easier later on.
+    effect_summary   *effects;         // NULL until its body is checked.
 
     // Constructor. Args: identifier.
     function_symbol(const pool_index);
@@ -363,6 +416,11 @@ public:
                                               //   block).
     void          open_scope();               // Self-explanatory.
     sym_index     close_scope();              // Self-explanatory.    
+    block_level   reopen_scope(sym_index);    // Make a closed routine the
+                                              //   current block again.
+                                              //   Returns the level to give
+                                              //   back to leave_scope().
+    void          leave_scope(block_level);   // Undo reopen_scope().
 
     // --- Symbol table methods. ---
     sym_index     lookup_symbol(const pool_index);      // Self-explanatory.
@@ -386,6 +444,25 @@ public:
     long          get_next_label();           // Generate next asm label.
     sym_index     gen_temp_var(sym_index);    // Generate, install and return
                                               // sym_index to next temp var.
+    int           is_temp_var(const sym_index); // Return 1 if the symbol
+                                              // is a temp var.
+    sym_index     gen_temp_const(sym_index,   // Generate, install and return
+                                 int);        // sym_index to a temp constant.
+                                              // Args: type, value (ieee
+                                              // for reals).
+    sym_index     gen_copy_var(sym_index);    // Generate, install and return
+                                              // a variable like the arg
+                                              // (see quadopt.cc).
+    effect_summary *get_effects(const sym_index); // Return the effect
+                                              // summary of a routine, or
+                                              // NULL if it isn't known.
+    sym_index     gen_clone(sym_index);       // Generate, install and return
+                                              // a copy of a procedure or
+                                              // function (see quadopt.cc).
+    void          note_display_use(sym_index); // Note that a variable is
+                                              // used by a routine nested
+                                              // inside the one it belongs
+                                              // to (see quads.cc).
     
     // These functions are used to enter identifiers into the symbol table,
     // depending on their context (function, constant, etc).